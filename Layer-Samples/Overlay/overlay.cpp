@@ -21,9 +21,24 @@
  */
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "util.hpp"
 #include <vk_loader_platform.h>
 #include <vulkan/vulkan.h>
@@ -37,24 +52,428 @@
 //#define STBTT_STATIC
 #include "stb_truetype.h"
 
-struct vertex {
-    float x, y, u, v;
+/* one instanced quad per glyph, expanded to a triangle strip by the vertex shader */
+struct glyph_instance {
+    float x0, y0, x1, y1;
+    float s0, t0, s1, t1;
 };
 
-#define MAX_TEXT_VERTICES 16384
+#define MAX_GLYPHS 1024
 #define FONT_SIZE_PIXELS 18
 #define FONT_ATLAS_SIZE 512
 
+/* the bottom-right texel of the atlas is left solid for drawing the graph */
+#define SOLID_TEXEL_UV ((FONT_ATLAS_SIZE - 0.5f) / FONT_ATLAS_SIZE)
+
+/* baked atlas cache file: header, glyph metrics, then the R8 atlas */
+#define GLYPH_CACHE_MAGIC 0x4347564f /* "OVGC" */
+#define GLYPH_CACHE_VERSION 1
+
+struct GlyphCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fontHash;
+    uint32_t fontSize;
+    uint32_t atlasSize;
+};
+
+/* read-only mapping of a whole file */
+struct MappedFile {
+    const unsigned char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    bool Open(const char *filename);
+    void Close();
+};
+
+#define FRAME_STATS_SAMPLES 128
+#define TIMESTAMP_FRAMES 8
+#define SUBMIT_TIMESTAMP_SLOTS 64
+#define QUEUE_BUSY_WINDOW_NS 1e9
+
+/* rolling window of frame times, in milliseconds */
+struct FrameStats {
+    float samples[FRAME_STATS_SAMPLES];
+    int count;
+    int next;
+
+    void Add(float ms);
+    float Get(int i) const; /* oldest first */
+    float Average() const;
+    float Percentile(float p) const;
+};
+
+/* quads for one line of HUD text, rebuilt only when the line or its position changes */
+struct TextLine {
+    std::string text;
+    float y;
+    std::vector<glyph_instance> glyphs;
+};
+
+/* a run of HUD lines and their quads, version moves whenever the quads do */
+struct TextBlock {
+    std::vector<TextLine> lines;
+    std::vector<glyph_instance> glyphs;
+    uint32_t version;
+};
+
+/* the HUD text for one swapchain image. the stable lines (title and memory stats) rarely change and are only copied to
+ * an image holding a stale version; the frame lines change every present and are always rewritten after them */
+struct HudText {
+    std::string stable;
+    std::string frame;
+};
+
+/* work recorded into a command buffer; the secondaries it executes are added in at submit */
+struct CommandBufferStats {
+    VkCommandPool pool;
+    uint32_t draws;
+    uint32_t pipelineBinds;
+    uint32_t descriptorBinds;
+    uint32_t pushConstants;
+    std::vector<VkCommandBuffer> secondaries;
+};
+
+/* bumped whenever CommandBufferStats are erased, so threads stop trusting their cached pointer, see get_cmd_stats */
+static std::atomic<uint64_t> cmd_stats_epoch(0);
+
+/* one VkSubmitInfo as the app submitted it */
+struct SubmitRecord {
+    int frame;
+    double cpuTimeUs;
+    uint32_t commandBuffers;
+    uint32_t waitSemaphores;
+    uint32_t signalSemaphores;
+
+    uint32_t draws;
+    uint32_t pipelineBinds;
+    uint32_t descriptorBinds;
+    uint32_t pushConstants;
+};
+
+/* a submit record waiting to be written to the trace file, gpu times are negative for batches that were not timed */
+struct TraceEntry {
+    SubmitRecord rec;
+    uint32_t family;
+    uint32_t index;
+    double gpuBegin;
+    double gpuEnd;
+};
+
+struct QueueData {
+    uint32_t family;
+    uint32_t index;
+
+    /* batch counts since the last present */
+    std::atomic<uint32_t> batches;
+    std::atomic<uint32_t> commandBuffers;
+    std::atomic<uint32_t> waitSemaphores;
+    std::atomic<uint32_t> signalSemaphores;
+
+    /* guards the timestamp slots and busy intervals, which presents on other queues collect and read too */
+    std::mutex lock;
+
+    /* optional timestamps around each batch, slots retire in submission order */
+    VkCommandPool pool;
+    VkQueryPool timestampPool;
+    uint64_t timestampMask;
+    VkCommandBuffer beginCmds[SUBMIT_TIMESTAMP_SLOTS];
+    VkCommandBuffer endCmds[SUBMIT_TIMESTAMP_SLOTS];
+    SubmitRecord records[SUBMIT_TIMESTAMP_SLOTS];
+    uint32_t oldest;
+    uint32_t pending;
+
+    /* merged busy intervals on the GPU timeline in ns, covering the window up to the last batch */
+    std::deque<std::pair<double, double>> busy;
+
+    float Utilization() const;
+};
+
+typedef std::unordered_map<VkQueue, QueueData *> QueueMap;
+
+/* device memory tracking, sizes bucketed by powers of 4 from 4 KB */
+#define MEMORY_HISTOGRAM_BUCKETS 9
+#define SMALL_ALLOCATION_SIZE (64 * 1024)
+
+struct MemoryAllocation {
+    uint32_t type;
+    VkDeviceSize size;
+    VkDeviceSize boundSize;
+};
+
+/* a buffer or image bound to an allocation, until it is destroyed */
+struct MemoryBinding {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+};
+
+/*
+ * api call tracing, enabled by VK_OVERLAY_API_TRACE=<path>.  each thread appends fixed size records to its own
+ * single-producer ring and a flush thread drains the rings to a binary file, see trace2json.py for the format
+ */
+#define API_TRACE_RING_SIZE 4096 /* records, power of two */
+#define API_TRACE_FLUSH_MS 10
+#define API_TRACE_MAGIC 0x54415056 /* "VPAT" */
+#define API_TRACE_VERSION 1
+
+#define API_TRACE_CALLS(X)    \
+    X(CreateInstance)         \
+    X(DestroyInstance)        \
+    X(CreateDevice)           \
+    X(DestroyDevice)          \
+    X(GetDeviceQueue)         \
+    X(CreateSwapchainKHR)     \
+    X(DestroySwapchainKHR)    \
+    X(GetSwapchainImagesKHR)  \
+    X(QueueSubmit)            \
+    X(QueuePresentKHR)        \
+    X(AllocateMemory)         \
+    X(FreeMemory)             \
+    X(BindBufferMemory)       \
+    X(BindImageMemory)        \
+    X(DestroyBuffer)          \
+    X(DestroyImage)           \
+    X(BeginCommandBuffer)     \
+    X(AllocateCommandBuffers) \
+    X(FreeCommandBuffers)     \
+    X(DestroyCommandPool)     \
+    X(CmdDraw)                \
+    X(CmdDrawIndexed)         \
+    X(CmdDrawIndirect)        \
+    X(CmdDrawIndexedIndirect) \
+    X(CmdBindPipeline)        \
+    X(CmdBindDescriptorSets)  \
+    X(CmdPushConstants)       \
+    X(CmdExecuteCommands)
+
+enum ApiTraceCall {
+#define API_TRACE_ENUM(name) API_CALL_##name,
+    API_TRACE_CALLS(API_TRACE_ENUM)
+#undef API_TRACE_ENUM
+    API_CALL_COUNT
+};
+
+static const char *const api_trace_call_names[API_CALL_COUNT] = {
+#define API_TRACE_NAME(name) "vk" #name,
+    API_TRACE_CALLS(API_TRACE_NAME)
+#undef API_TRACE_NAME
+};
+
+struct ApiTraceRecord {
+    uint64_t start;    /* ns since the trace began */
+    uint32_t duration; /* ns */
+    uint16_t call;
+    uint16_t thread;
+};
+static_assert(sizeof(ApiTraceRecord) == 16, "trace2json.py expects 16 byte records");
+
+struct ApiTraceRing {
+    ApiTraceRecord records[API_TRACE_RING_SIZE];
+    std::atomic<uint32_t> head; /* only written by the owning thread */
+    std::atomic<uint32_t> tail; /* only written by the flush thread */
+    std::atomic<uint32_t> dropped;
+    uint16_t thread;
+};
+
+static std::atomic<bool> api_trace_enabled(false);
+static std::chrono::steady_clock::time_point api_trace_start;
+
+/* rings outlive their threads: one that exits hands its ring, with whatever the flush thread has not drained yet and
+ * its thread index, to the next thread that traces. so there are only as many rings as threads ever traced at once */
+static std::mutex api_trace_lock;
+static std::vector<ApiTraceRing *> api_trace_rings;
+static std::vector<ApiTraceRing *> api_trace_free_rings;
+static int api_trace_instances;
+static FILE *api_trace_file;
+static std::thread api_trace_thread;
+static std::condition_variable api_trace_cv;
+static bool api_trace_stop;
+
+static inline uint64_t api_trace_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - api_trace_start).count();
+}
+
+/* null when every thread index is taken */
+static ApiTraceRing *acquire_trace_ring() {
+    std::lock_guard<std::mutex> lock(api_trace_lock);
+    if (!api_trace_free_rings.empty()) {
+        ApiTraceRing *ring = api_trace_free_rings.back();
+        api_trace_free_rings.pop_back();
+        return ring;
+    }
+
+    if (api_trace_rings.size() > UINT16_MAX) return nullptr;
+
+    ApiTraceRing *ring = new ApiTraceRing;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->dropped.store(0, std::memory_order_relaxed);
+    ring->thread = (uint16_t)api_trace_rings.size();
+    api_trace_rings.push_back(ring);
+
+    return ring;
+}
+
+/* gives the ring back when its thread exits */
+struct ApiTraceRingOwner {
+    ~ApiTraceRingOwner() {
+        if (!ring) return;
+
+        std::lock_guard<std::mutex> lock(api_trace_lock);
+        api_trace_free_rings.push_back(ring);
+    }
+
+    ApiTraceRing *ring; /* zero initialized like any thread_local */
+};
+
+static thread_local ApiTraceRingOwner tls_trace_ring;
+
+/* times the rest of the enclosing hook, a relaxed load and nothing else while tracing is off */
+struct ApiTraceScope {
+    ApiTraceScope(ApiTraceCall c) : call(c), start(api_trace_enabled.load(std::memory_order_relaxed) ? api_trace_now() : UINT64_MAX) {}
+
+    ~ApiTraceScope() {
+        if (start == UINT64_MAX) return;
+
+        uint64_t duration = api_trace_now() - start;
+        if (!tls_trace_ring.ring) tls_trace_ring.ring = acquire_trace_ring();
+        ApiTraceRing *ring = tls_trace_ring.ring;
+        if (!ring) return;
+
+        /* drop rather than block when the flush thread falls behind */
+        uint32_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) >= API_TRACE_RING_SIZE) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        ApiTraceRecord &rec = ring->records[head & (API_TRACE_RING_SIZE - 1)];
+        rec.start = start;
+        rec.duration = (uint32_t)std::min<uint64_t>(duration, UINT32_MAX);
+        rec.call = (uint16_t)call;
+        rec.thread = ring->thread;
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    ApiTraceCall call;
+    uint64_t start;
+};
+
+#define API_TRACE(name) ApiTraceScope api_trace_scope(API_CALL_##name)
+
+static void flush_api_trace() {
+    std::vector<ApiTraceRing *> rings;
+    {
+        std::lock_guard<std::mutex> lock(api_trace_lock);
+        rings = api_trace_rings;
+    }
+
+    for (auto ring : rings) {
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            uint32_t index = tail & (API_TRACE_RING_SIZE - 1);
+            uint32_t count = std::min(head - tail, API_TRACE_RING_SIZE - index);
+            fwrite(&ring->records[index], sizeof(ApiTraceRecord), count, api_trace_file);
+            tail += count;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+}
+
+static void api_trace_loop() {
+    std::unique_lock<std::mutex> lock(api_trace_lock);
+    while (!api_trace_stop) {
+        api_trace_cv.wait_for(lock, std::chrono::milliseconds(API_TRACE_FLUSH_MS));
+
+        lock.unlock();
+        flush_api_trace();
+        lock.lock();
+    }
+}
+
+/* the trace spans from the first instance created to the last one destroyed */
+static void begin_api_trace() {
+    std::lock_guard<std::mutex> lock(api_trace_lock);
+    if (api_trace_instances++) return;
+
+    const char *path = getenv("VK_OVERLAY_API_TRACE");
+    if (!path || !*path) return;
+
+    api_trace_file = fopen(path, "wb");
+    if (!api_trace_file) return;
+
+    /* header: magic, version, call count, then the call names as length prefixed strings */
+    uint32_t header[3] = {API_TRACE_MAGIC, API_TRACE_VERSION, API_CALL_COUNT};
+    fwrite(header, sizeof(header), 1, api_trace_file);
+    for (auto name : api_trace_call_names) {
+        uint8_t len = (uint8_t)strlen(name);
+        fwrite(&len, 1, 1, api_trace_file);
+        fwrite(name, len, 1, api_trace_file);
+    }
+
+    /* discard anything left over from a previous trace */
+    for (auto ring : api_trace_rings) {
+        ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+        ring->dropped.store(0, std::memory_order_relaxed);
+    }
+
+    api_trace_start = std::chrono::steady_clock::now();
+    api_trace_stop = false;
+    api_trace_thread = std::thread(api_trace_loop);
+    api_trace_enabled.store(true, std::memory_order_release);
+}
+
+static void end_api_trace() {
+    {
+        std::lock_guard<std::mutex> lock(api_trace_lock);
+        if (--api_trace_instances || !api_trace_file) return;
+
+        api_trace_enabled.store(false, std::memory_order_relaxed);
+        api_trace_stop = true;
+    }
+
+    api_trace_cv.notify_one();
+    api_trace_thread.join();
+    flush_api_trace();
+
+    fclose(api_trace_file);
+    api_trace_file = nullptr;
+
+    uint32_t dropped = 0;
+    for (auto ring : api_trace_rings) dropped += ring->dropped.load(std::memory_order_relaxed);
+    if (dropped) fprintf(stderr, "overlay: %u api trace records dropped\n", dropped);
+}
+
+/* one overlay submit per present, covering every swapchain in it */
+#define OVERLAY_SUBMITS 8
+
+struct OverlaySubmit {
+    VkFence fence;
+    VkSemaphore semaphore;
+    uint64_t serial; /* 0 while unused */
+};
+
 struct WsiImageData {
     VkImage image;
     VkImageView view;
     VkFramebuffer framebuffer;
+
+    /* cmd is idle once the overlay submit with this serial has retired */
     VkCommandBuffer cmd;
+    uint64_t submitSerial;
 
+    /* persistently mapped, the stable text glyphs first, then the frame text and the graph */
     VkBuffer vertexBuffer;
     VkDeviceMemory vertexBufferMemory;
-    int numVertices;
-    VkDeviceSize vertexBufferSize;
+    glyph_instance *mappedGlyphs;
+    uint32_t numGlyphs;
+    uint32_t numStableGlyphs;
+    uint32_t stableVersion;
 
     void Cleanup(VkDevice dev);
 };
@@ -68,6 +487,9 @@ struct SwapChainData {
 
     std::vector<WsiImageData *> presentableImages;
 
+    /* once destroyed, the last overlay submit that may draw with it */
+    uint64_t retireSerial;
+
     void Cleanup(VkDevice dev);
 };
 
@@ -75,6 +497,12 @@ struct layer_data {
     VkLayerDispatchTable *device_dispatch_table;
     VkLayerInstanceDispatchTable *instance_dispatch_table;
 
+    /* instance only */
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR pfnGetPhysicalDeviceMemoryProperties2;
+
+    /* guards the per-device state below that hooks on different threads share */
+    loader_platform_thread_mutex lock;
+
     PFN_vkCreateSwapchainKHR pfnCreateSwapchainKHR;
     PFN_vkGetSwapchainImagesKHR pfnGetSwapchainImagesKHR;
     PFN_vkQueuePresentKHR pfnQueuePresentKHR;
@@ -82,7 +510,9 @@ struct layer_data {
 
     VkPhysicalDevice gpu;
     VkDevice dev;
+    /* the app's first queue family when it created no graphics queue */
     uint32_t graphicsQueueFamilyIndex;
+    bool hasGraphicsQueue;
 
     PFN_vkSetDeviceLoaderData pfn_dev_init;
     std::unordered_map<VkSwapchainKHR, SwapChainData *> *swapChains;
@@ -97,41 +527,172 @@ struct layer_data {
     VkImageView fontGlyphsImageView;
     VkDeviceMemory fontGlyphsMemory;
     stbtt_bakedchar glyphs[96];
+
+    TextBlock stableText;
+    TextBlock frameText;
     VkCommandBuffer fontUploadCmdBuffer;
-    bool fontUploadComplete;
+    VkFence fontUploadFence;
+    bool fontUploadSubmitted;
+    VkBuffer fontStagingBuffer;
+    VkDeviceMemory fontStagingMemory;
 
     VkDescriptorSetLayout dsl;
     VkPipelineLayout pl;
     VkDescriptorPool desc_pool;
     VkDescriptorSet desc_set;
     VkSampler sampler;
-    VkFence fence;
 
-    int frame;
-    int cmdBuffersThisFrame;
+    VkPhysicalDeviceMemoryProperties memoryProps;
+    uint32_t maxMemoryAllocationCount;
+    bool memoryBudget;
+    std::unordered_map<VkDeviceMemory, MemoryAllocation> allocations;
+    std::unordered_map<VkBuffer, MemoryBinding> bufferBindings;
+    std::unordered_map<VkImage, MemoryBinding> imageBindings;
+    VkDeviceSize heapAllocated[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heapBound[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize typeAllocated[VK_MAX_MEMORY_TYPES];
+    uint32_t typeAllocations[VK_MAX_MEMORY_TYPES];
+    uint32_t allocationHistogram[MEMORY_HISTOGRAM_BUCKETS];
+    uint32_t smallAllocations;
+
+    /* serializes the overlay work of presents, so that the device lock is not held over its waits and submit. guards
+     * the command pool, the font upload, the submit slots, the retired swapchains and the HUD layout. may be taken
+     * with the device lock held, but never the other way around */
+    std::mutex presentLock;
+    OverlaySubmit overlaySubmits[OVERLAY_SUBMITS];
+    uint64_t presentSerial;
+    /* destroyed by the app, their overlay resources are freed once retireSerial has retired */
+    std::vector<SwapChainData *> retiredSwapChains;
+
+    std::vector<VkQueueFamilyProperties> queueFamilyProps;
+    /* submits look queues up without any lock: vkGetDeviceQueue publishes a new copy under the device lock, and the
+     * copies it replaces are kept until the device is destroyed as a submit may still be reading them */
+    std::atomic<QueueMap *> queues;
+    std::vector<QueueMap *> retiredQueueMaps;
+    bool queueTiming;
+
+    /* per-submit trace, CSV unless the file name ends in .json. records are queued under traceQueuedLock and
+     * written by the next present; traceLock keeps the file in order across presenting threads */
+    FILE *traceFile;
+    bool traceJson;
+    bool traceEmpty;
+    std::vector<TraceEntry> traceQueued;
+    std::mutex traceQueuedLock;
+    std::vector<TraceEntry> traceWriting;
+    std::mutex traceLock;
+    std::chrono::steady_clock::time_point startTime;
+    /* entries are erased when their command buffer or pool is freed, which bumps cmd_stats_epoch. guarded by
+     * cmdStatsLock rather than the device lock, and only held for the map accesses */
+    std::unordered_map<VkCommandBuffer, CommandBufferStats> cmdBufferStats;
+    std::mutex cmdStatsLock;
+
+    /* GPU time of a frame spans from the first batch submitted to a graphics queue, once its semaphore waits are
+     * done, to the end of the overlay draw. the begin half of each slot is recorded at the stage that batch waits at */
+    VkQueryPool timestampPool;
+    uint64_t timestampMask;
+    float timestampPeriod;
+    VkCommandBuffer timestampCmds[TIMESTAMP_FRAMES];
+    VkPipelineStageFlagBits timestampStages[TIMESTAMP_FRAMES];
+    bool timestampPending[TIMESTAMP_FRAMES];
+    bool timestampBegun;
+
+    std::chrono::steady_clock::time_point lastPresent;
+    FrameStats cpuFrameTimes;
+    FrameStats gpuFrameTimes;
+
+    /* read and bumped by submits on any thread without the device lock */
+    std::atomic<int> frame;
+    std::atomic<int> cmdBuffersThisFrame;
+    std::atomic<int> drawsThisFrame;
+    std::atomic<int> pipelineBindsThisFrame;
+    std::atomic<int> descriptorBindsThisFrame;
+    std::atomic<int> pushConstantsThisFrame;
 
     void Cleanup();
 };
 
-static std::unordered_map<void *, layer_data *> layer_data_map;
+/* Every hooked call looks up its dispatch key, so lookups read an immutable
+ * snapshot of the map without taking a lock. Creating or destroying an
+ * instance or device copies the snapshot under layer_data_lock and publishes
+ * the copy. Other threads may still be reading an old snapshot, so lookups
+ * are counted in a few reader slots shared out between threads, and replaced
+ * snapshots are freed by the first publish that finds every slot empty.
+ */
+typedef std::unordered_map<void *, layer_data *> layer_data_table;
+
+#define LAYER_DATA_READER_SLOTS 16 /* power of two */
+
+/* one cache line each so that threads on different slots don't contend */
+struct alignas(64) LayerDataReaders {
+    std::atomic<uint32_t> count;
+};
+
+static const layer_data_table empty_layer_data_map;
+static std::atomic<const layer_data_table *> layer_data_map(&empty_layer_data_map);
+static std::vector<const layer_data_table *> retired_layer_data_maps;
+static std::mutex layer_data_lock;
+static LayerDataReaders layer_data_readers[LAYER_DATA_READER_SLOTS];
+static std::atomic<uint32_t> layer_data_next_slot(0);
+
+static thread_local LayerDataReaders &tls_layer_data_readers =
+    layer_data_readers[layer_data_next_slot.fetch_add(1, std::memory_order_relaxed) & (LAYER_DATA_READER_SLOTS - 1)];
+
+static layer_data *get_layer_data(void *key) {
+    /* seq_cst pairs the count with the load of the map against publish_layer_data_map */
+    LayerDataReaders &readers = tls_layer_data_readers;
+    readers.count.fetch_add(1);
+    const layer_data_table *table = layer_data_map.load();
+
+    auto got = table->find(key);
+    assert(got != table->end());
+    layer_data *data = got->second;
+
+    readers.count.fetch_sub(1, std::memory_order_release);
+    return data;
+}
+
+static void publish_layer_data_map(const layer_data_table *table) {
+    const layer_data_table *old = layer_data_map.load(std::memory_order_relaxed);
+    layer_data_map.store(table);
+
+    if (old != &empty_layer_data_map) retired_layer_data_maps.push_back(old);
+
+    /* a reader that shows up after this can only see the new table */
+    for (auto &readers : layer_data_readers) {
+        if (readers.count.load()) return;
+    }
+
+    for (auto retired : retired_layer_data_maps) delete retired;
+    retired_layer_data_maps.clear();
+}
+
+static layer_data *add_layer_data(void *key) {
+    layer_data *data = new layer_data;
+    loader_platform_thread_create_mutex(&data->lock);
+
+    std::lock_guard<std::mutex> lock(layer_data_lock);
+    layer_data_table *table = new layer_data_table(*layer_data_map.load(std::memory_order_relaxed));
+    (*table)[key] = data;
+    publish_layer_data_map(table);
+
+    return data;
+}
 
-template layer_data *GetLayerDataPtr<layer_data>(void *data_key, std::unordered_map<void *, layer_data *> &data_map);
+static void remove_layer_data(void *key) {
+    std::lock_guard<std::mutex> lock(layer_data_lock);
+    layer_data_table *table = new layer_data_table(*layer_data_map.load(std::memory_order_relaxed));
 
-// static LOADER_PLATFORM_THREAD_ONCE_DECLARATION(g_initOnce);
-// TODO : This can be much smarter, using separate locks for separate global
-// data
-static int globalLockInitialized = 0;
-static loader_platform_thread_mutex globalLock;
+    auto got = table->find(key);
+    assert(got != table->end());
+    loader_platform_thread_delete_mutex(&got->second->lock);
+    delete got->second;
+    table->erase(got);
 
-static void init_overlay(layer_data *my_data) {
-    if (!globalLockInitialized) {
-        // TODO/TBD: Need to delete this mutex sometime.  How???  One
-        // suggestion is to call this during vkCreateInstance(), and then we
-        // can clean it up during vkDestroyInstance().  However, that requires
-        // that the layer have per-instance locks.  We need to come back and
-        // address this soon.
-        loader_platform_thread_create_mutex(&globalLock);
-        globalLockInitialized = 1;
+    if (table->empty()) {
+        delete table;
+        publish_layer_data_map(&empty_layer_data_map);
+    } else {
+        publish_layer_data_map(table);
     }
 }
 
@@ -162,8 +723,119 @@ static bool get_file_contents(char const *filename, std::vector<unsigned char> &
     return true;
 }
 
+bool MappedFile::Open(const char *filename) {
+    data = nullptr;
+    size = 0;
+
+#ifdef _WIN32
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart) mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || !st.st_size) {
+        close(fd);
+        return false;
+    }
+
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) return false;
+
+    data = (const unsigned char *)ptr;
+    size = st.st_size;
+#endif
+
+    return true;
+}
+
+void MappedFile::Close() {
+    if (!data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    munmap((void *)data, size);
+#endif
+    data = nullptr;
+}
+
+/* FNV-1a */
+static uint64_t hash_bytes(const std::vector<unsigned char> &bytes) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto b : bytes) hash = (hash ^ b) * 0x100000001b3ull;
+    return hash;
+}
+
+static std::string glyph_cache_path(uint64_t fontHash) {
+    const char *dir = getenv("VK_OVERLAY_CACHE_DIR");
+#ifdef _WIN32
+    if (!dir) dir = getenv("TEMP");
+    if (!dir) dir = ".";
+#else
+    if (!dir) dir = getenv("TMPDIR");
+    if (!dir) dir = "/tmp";
+#endif
+
+    char name[64];
+    snprintf(name, sizeof(name), "/overlay-glyphs-%016llx-%d.bin", (unsigned long long)fontHash, FONT_SIZE_PIXELS);
+    return std::string(dir) + name;
+}
+
+/* written to a temporary name first so concurrent launches never map a partial file. the name is unique to this
+ * process and created exclusively, so nothing another process left or planted there in a shared directory is
+ * followed or written through */
+static void write_glyph_cache(const std::string &path, const GlyphCacheHeader &header, const stbtt_bakedchar *glyphs,
+                              const std::vector<unsigned char> &atlas) {
+#ifdef _WIN32
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%lu.tmp", (unsigned long)GetCurrentProcessId());
+    std::string tmp = path + suffix;
+    FILE *f = fopen(tmp.c_str(), "wbx");
+#else
+    std::string tmp = path + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0) return;
+
+    /* readable by other users like the files it replaces */
+    fchmod(fd, 0644);
+    FILE *f = fdopen(fd, "wb");
+    if (!f) {
+        close(fd);
+        remove(tmp.c_str());
+    }
+#endif
+    if (!f) return;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(glyphs, sizeof(stbtt_bakedchar), 96, f) == 96 &&
+              fwrite(atlas.data(), 1, atlas.size(), f) == atlas.size();
+    ok = !fclose(f) && ok;
+
+    if (!ok || rename(tmp.c_str(), path.c_str())) remove(tmp.c_str());
+}
+
 static bool compile_shader(VkDevice device, char const *filename, VkShaderModule *module) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
 
     std::vector<unsigned char> bytecode;
     if (!get_file_contents(filename, bytecode)) {
@@ -190,7 +862,7 @@ static bool compile_shader(VkDevice device, char const *filename, VkShaderModule
 }
 
 static uint32_t choose_memory_type(VkPhysicalDevice gpu, uint32_t typeBits, VkMemoryPropertyFlags properties) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(gpu), layer_data_map);
+    layer_data *my_data = get_layer_data(get_dispatch_key(gpu));
 
     VkPhysicalDeviceMemoryProperties props;
     my_data->instance_dispatch_table->GetPhysicalDeviceMemoryProperties(gpu, &props);
@@ -205,50 +877,266 @@ static uint32_t choose_memory_type(VkPhysicalDevice gpu, uint32_t typeBits, VkMe
     return 0;
 }
 
-static int fill_vertex_buffer(layer_data *data, vertex *vertices, int index) {
-    char str[1024];
-    sprintf(str,
-            "Vulkan Overlay Example\nWSI Image Index: %d\nFrame: "
-            "%d\nCmdBuffers: %d",
-            index, data->frame++, data->cmdBuffersThisFrame);
-    float x = 0;
-    float y = 16;
+void FrameStats::Add(float ms) {
+    samples[next] = ms;
+    next = (next + 1) % FRAME_STATS_SAMPLES;
+    if (count < FRAME_STATS_SAMPLES) count++;
+}
+
+float FrameStats::Get(int i) const { return samples[(next - count + i + FRAME_STATS_SAMPLES) % FRAME_STATS_SAMPLES]; }
+
+float FrameStats::Average() const {
+    if (!count) return 0.0f;
+
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    return sum / count;
+}
+
+float FrameStats::Percentile(float p) const {
+    if (!count) return 0.0f;
+
+    float sorted[FRAME_STATS_SAMPLES];
+    memcpy(sorted, samples, sizeof(float) * count);
+
+    int n = std::min(count - 1, (int)(p * count));
+    std::nth_element(sorted, sorted + n, sorted + count);
+    return sorted[n];
+}
+
+float QueueData::Utilization() const {
+    if (busy.empty()) return 0.0f;
+
+    double windowBegin = busy.back().second - QUEUE_BUSY_WINDOW_NS;
+    double sum = 0.0;
+    for (auto &b : busy) {
+        if (b.second > windowBegin) sum += b.second - std::max(b.first, windowBegin);
+    }
+
+    return (float)(sum / QUEUE_BUSY_WINDOW_NS);
+}
+
+/* lays out HUD text from y down into block.glyphs, keeping at most maxGlyphs and bumping the version if they changed */
+static void layout_text(layer_data *data, TextBlock &block, const char *str, float y, size_t maxGlyphs) {
+    bool dirty = false;
+    size_t line = 0;
+
+    for (char const *p = str;; line++) {
+        char const *end = strchr(p, '\n');
+        if (!end) end = p + strlen(p);
+
+        if (line >= block.lines.size()) block.lines.resize(line + 1);
+        TextLine &tl = block.lines[line];
+
+        if (tl.text.compare(0, std::string::npos, p, end - p) != 0 || tl.y != y) {
+            tl.text.assign(p, end);
+            tl.y = y;
+            tl.glyphs.clear();
+
+            float x = 0;
+            for (char const *c = p; c < end; c++) {
+                stbtt_aligned_quad q;
+                stbtt_GetBakedQuad(data->glyphs, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE, *c - 32, &x, &y, &q, 1);
+
+                glyph_instance g = {q.x0, q.y0, q.x1, q.y1, q.s0, q.t0, q.s1, q.t1};
+                tl.glyphs.push_back(g);
+            }
+
+            dirty = true;
+        }
+
+        if (!*end) break;
+        p = end + 1;
+        y += 16;
+    }
+
+    if (block.lines.size() != line + 1) {
+        block.lines.resize(line + 1);
+        dirty = true;
+    }
+
+    if (!dirty && block.glyphs.size() <= maxGlyphs) return;
+
+    block.glyphs.clear();
+    for (auto &tl : block.lines) block.glyphs.insert(block.glyphs.end(), tl.glyphs.begin(), tl.glyphs.end());
+    if (block.glyphs.size() > maxGlyphs) block.glyphs.resize(maxGlyphs);
+    block.version++;
+}
+
+/* appends to a HUD string, silently truncating */
+static void hud_printf(char *str, size_t size, const char *format, ...) {
+    size_t len = strlen(str);
+    if (len + 1 >= size) return;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(str + len, size - len, format, args);
+    va_end(args);
+}
+
+static unsigned memory_histogram_bucket(VkDeviceSize size) {
+    unsigned bucket = 0;
+    for (VkDeviceSize limit = 4096; size >= limit && bucket < MEMORY_HISTOGRAM_BUCKETS - 1; limit *= 4) bucket++;
+    return bucket;
+}
+
+static void print_memory_stats(layer_data *data, char *str, size_t size) {
+    static const char *const bucketNames[MEMORY_HISTOGRAM_BUCKETS] = {"<4K", "4K", "16K", "64K", "256K", "1M", "4M", "16M", "64M+"};
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget;
+    if (data->memoryBudget) {
+        layer_data *instance_data = get_layer_data(get_dispatch_key(data->gpu));
+
+        memset(&budget, 0, sizeof(budget));
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
 
-    vertex *v = vertices;
+        VkPhysicalDeviceMemoryProperties2KHR props2;
+        props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        props2.pNext = &budget;
+        instance_data->pfnGetPhysicalDeviceMemoryProperties2(data->gpu, &props2);
+    }
+
+    const float mb = 1.0f / (1024 * 1024);
+    for (uint32_t heap = 0; heap < data->memoryProps.memoryHeapCount; heap++) {
+        uint32_t allocations = 0;
+        for (uint32_t type = 0; type < data->memoryProps.memoryTypeCount; type++) {
+            if (data->memoryProps.memoryTypes[type].heapIndex == heap) allocations += data->typeAllocations[type];
+        }
 
-    for (char const *p = str; *p; p++) {
-        if (*p == '\n') {
-            y += 16;
-            x = 0;
+        hud_printf(str, size, "\nHeap %u: %.1f MB in %u allocs, %.1f MB bound", heap, data->heapAllocated[heap] * mb, allocations,
+                   data->heapBound[heap] * mb);
+        if (data->memoryBudget) {
+            hud_printf(str, size, ", process %.1f / %.1f MB budget", budget.heapUsage[heap] * mb, budget.heapBudget[heap] * mb);
         } else {
-            stbtt_aligned_quad q;
-            stbtt_GetBakedQuad(data->glyphs, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE, *p - 32, &x, &y, &q, 1);
-
-            v[0].x = q.x0;
-            v[0].y = q.y0;
-            v[0].u = q.s0;
-            v[0].v = q.t0;
-            v[1].x = q.x1;
-            v[1].y = q.y0;
-            v[1].u = q.s1;
-            v[1].v = q.t0;
-            v[2].x = q.x0;
-            v[2].y = q.y1;
-            v[2].u = q.s0;
-            v[2].v = q.t1;
-
-            v[3] = v[1];
-            v[4].x = q.x1;
-            v[4].y = q.y1;
-            v[4].u = q.s1;
-            v[4].v = q.t1;
-            v[5] = v[2];
-
-            v += 6;
+            hud_printf(str, size, ", %.1f MB heap", data->memoryProps.memoryHeaps[heap].size * mb);
+        }
+
+        for (uint32_t type = 0; type < data->memoryProps.memoryTypeCount; type++) {
+            if (data->memoryProps.memoryTypes[type].heapIndex != heap || !data->typeAllocations[type]) continue;
+            hud_printf(str, size, "\n  type %u: %.1f MB in %u allocs", type, data->typeAllocated[type] * mb, data->typeAllocations[type]);
+        }
+    }
+
+    hud_printf(str, size, "\nAlloc sizes:");
+    for (unsigned i = 0; i < MEMORY_HISTOGRAM_BUCKETS; i++) {
+        if (data->allocationHistogram[i]) hud_printf(str, size, " %s:%u", bucketNames[i], data->allocationHistogram[i]);
+    }
+
+    /* many small allocations run into maxMemoryAllocationCount and per-allocation driver overhead */
+    uint32_t total = (uint32_t)data->allocations.size();
+    if (total > data->maxMemoryAllocationCount / 2) {
+        hud_printf(str, size, "\nWARNING: %u of %u allowed allocations", total, data->maxMemoryAllocationCount);
+    } else if (data->smallAllocations >= 64 && data->smallAllocations * 2 > total) {
+        hud_printf(str, size, "\nWARNING: %u of %u allocations are under 64K, suballocate", data->smallAllocations, total);
+    }
+}
+
+/* formats the HUD text for one swapchain image, called with the device lock held */
+static void format_hud(layer_data *data, int index, HudText &hud) {
+    char str[2048];
+    const size_t size = sizeof(str);
+
+    snprintf(str, size, "Vulkan Overlay Example");
+    print_memory_stats(data, str, size);
+    hud.stable = str;
+
+    snprintf(str, size,
+             "WSI Image Index: %d\nFrame: "
+             "%d\nCPU: %.2f ms avg, %.2f ms p99\nGPU: %.2f ms avg, %.2f ms p99\n"
+             "CmdBuffers: %d\nDraws: %d\nBinds: %d pipelines, %d descriptor sets, %d push constants",
+             index, data->frame++, data->cpuFrameTimes.Average(), data->cpuFrameTimes.Percentile(0.99f),
+             data->gpuFrameTimes.Average(), data->gpuFrameTimes.Percentile(0.99f), data->cmdBuffersThisFrame.load(),
+             data->drawsThisFrame.load(), data->pipelineBindsThisFrame.load(), data->descriptorBindsThisFrame.load(),
+             data->pushConstantsThisFrame.load());
+
+    for (auto &q : *data->queues.load(std::memory_order_acquire)) {
+        QueueData *qd = q.second;
+        hud_printf(str, size, "\nQueue %u.%u: %u batches, %u cmds, %u waits, %u signals", qd->family, qd->index,
+                   qd->batches.load(), qd->commandBuffers.load(), qd->waitSemaphores.load(), qd->signalSemaphores.load());
+        if (qd->timestampPool != VK_NULL_HANDLE) {
+            std::lock_guard<std::mutex> queueLock(qd->lock);
+            hud_printf(str, size, ", %.0f%% busy", qd->Utilization() * 100.0f);
         }
     }
+    hud.frame = str;
+}
+
+/* lays out the HUD text and the CPU frame time graph in the image's vertex buffer */
+static void fill_glyph_buffer(layer_data *data, WsiImageData *id, const HudText &hud, const FrameStats &cpuFrameTimes) {
+    const size_t maxTextGlyphs = MAX_GLYPHS - FRAME_STATS_SAMPLES;
+
+    /* only copy the stable lines when this image holds a stale version */
+    layout_text(data, data->stableText, hud.stable.c_str(), 16, maxTextGlyphs);
+    if (id->stableVersion != data->stableText.version) {
+        id->numStableGlyphs = (uint32_t)data->stableText.glyphs.size();
+        memcpy(id->mappedGlyphs, data->stableText.glyphs.data(), sizeof(glyph_instance) * id->numStableGlyphs);
+        id->stableVersion = data->stableText.version;
+    }
+
+    /* the frame lines go below them and are rewritten every time */
+    size_t lines = data->stableText.lines.size();
+    layout_text(data, data->frameText, hud.frame.c_str(), 16 * (lines + 1), maxTextGlyphs - id->numStableGlyphs);
+    glyph_instance *g = id->mappedGlyphs + id->numStableGlyphs;
+    memcpy(g, data->frameText.glyphs.data(), sizeof(glyph_instance) * data->frameText.glyphs.size());
+    g += data->frameText.glyphs.size();
+    lines += data->frameText.lines.size();
+
+    /* CPU frame time graph below the text, one unit per frame and two per millisecond */
+    float base = 16 * lines + 72;
+    for (int i = 0; i < cpuFrameTimes.count; i++, g++) {
+        float h = std::min(cpuFrameTimes.Get(i) * 2.0f, 64.0f);
+
+        g->x0 = (float)i;
+        g->y0 = base - h;
+        g->x1 = (float)i + 1.0f;
+        g->y1 = base;
+        g->s0 = g->t0 = g->s1 = g->t1 = SOLID_TEXEL_UV;
+    }
+
+    id->numGlyphs = (uint32_t)(g - id->mappedGlyphs);
+}
+
+static void submit_font_upload(layer_data *data, VkQueue queue) {
+    VkSubmitInfo si = {};
+    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.commandBufferCount = 1;
+    si.pCommandBuffers = &data->fontUploadCmdBuffer;
+    VkResult U_ASSERT_ONLY err = data->device_dispatch_table->QueueSubmit(queue, 1, &si, data->fontUploadFence);
+    assert(!err);
+
+    data->fontUploadSubmitted = true;
+}
+
+/* records the begin half of a frame timestamp slot, called with presentLock held as it shares the command pool */
+static void record_frame_begin(layer_data *data, uint32_t slot, VkPipelineStageFlagBits stage) {
+    VkLayerDispatchTable *pTable = data->device_dispatch_table;
+    VkCommandBuffer tcmd = data->timestampCmds[slot];
+
+    VkCommandBufferBeginInfo cbbi = {};
+    cbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    return (int)(v - vertices);
+    pTable->BeginCommandBuffer(tcmd, &cbbi);
+    pTable->CmdResetQueryPool(tcmd, data->timestampPool, slot * 2, 2);
+    pTable->CmdWriteTimestamp(tcmd, stage, data->timestampPool, slot * 2);
+    pTable->EndCommandBuffer(tcmd);
+
+    data->timestampStages[slot] = stage;
+}
+
+/* a timestamp at the top of the pipe is not held back by the batch's semaphore waits, and would count the wait for the
+ * swapchain image as GPU time. it goes at the earliest stage the batch waits at instead */
+static VkPipelineStageFlagBits frame_begin_stage(const VkSubmitInfo &submit) {
+    VkPipelineStageFlags stages = 0;
+    for (uint32_t i = 0; i < submit.waitSemaphoreCount; i++) stages |= submit.pWaitDstStageMask[i];
+
+    /* waiting at the top of the pipe holds nothing back */
+    stages &= ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (!stages) return VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (stages & (VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT))
+        return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    /* stage bits are in pipeline order */
+    return (VkPipelineStageFlagBits)(stages & ~(stages - 1));
 }
 
 static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_data *data) {
@@ -256,8 +1144,18 @@ static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_dat
 
     data->gpu = gpu;
     data->dev = device;
+    data->queues = new QueueMap;
     data->frame = 0;
     data->cmdBuffersThisFrame = 0;
+    data->drawsThisFrame = 0;
+    data->pipelineBindsThisFrame = 0;
+    data->descriptorBindsThisFrame = 0;
+    data->pushConstantsThisFrame = 0;
+    data->stableText.version = 0;
+    data->frameText.version = 0;
+    data->timestampBegun = false;
+    data->cpuFrameTimes.count = data->cpuFrameTimes.next = 0;
+    data->gpuFrameTimes.count = data->gpuFrameTimes.next = 0;
 
     VkLayerDispatchTable *pTable = data->device_dispatch_table;
 
@@ -283,27 +1181,55 @@ static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_dat
     compile_shader(device, VULKAN_SAMPLES_BASE_DIR "/Layer-Samples/data/overlay-vert.spv", &data->vsShaderModule);
     compile_shader(device, VULKAN_SAMPLES_BASE_DIR "/Layer-Samples/data/overlay-frag.spv", &data->fsShaderModule);
 
-    /* Upload the font bitmap */
-    VkImageCreateInfo ici;
-    memset(&ici, 0, sizeof(ici));
-    ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    ici.imageType = VK_IMAGE_TYPE_2D;
-    ici.format = VK_FORMAT_R8_UNORM;
-    ici.extent.width = FONT_ATLAS_SIZE;
-    ici.extent.height = FONT_ATLAS_SIZE;
-    ici.extent.depth = 1;
-    ici.mipLevels = 1;
-    ici.arrayLayers = 1;
-    ici.samples = VK_SAMPLE_COUNT_1_BIT;
-    ici.tiling = VK_IMAGE_TILING_LINEAR;
-    ici.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-    ici.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+    /* Load the glyph atlas from the cache, baking and caching it if it is missing or stale */
+    std::vector<unsigned char> fontData;
+    get_file_contents(VULKAN_SAMPLES_BASE_DIR "/Layer-Samples/data/FreeSans.ttf", fontData);
 
-    err = pTable->CreateImage(device, &ici, nullptr, &data->fontGlyphsImage);
-    assert(!err);
+    GlyphCacheHeader header;
+    header.magic = GLYPH_CACHE_MAGIC;
+    header.version = GLYPH_CACHE_VERSION;
+    header.fontHash = hash_bytes(fontData);
+    header.fontSize = FONT_SIZE_PIXELS;
+    header.atlasSize = FONT_ATLAS_SIZE;
+
+    const size_t atlasBytes = FONT_ATLAS_SIZE * FONT_ATLAS_SIZE;
+    const size_t cacheBytes = sizeof(header) + sizeof(data->glyphs) + atlasBytes;
+
+    std::string cachePath = glyph_cache_path(header.fontHash);
+    std::vector<unsigned char> baked;
+    const unsigned char *atlas = nullptr;
+
+    MappedFile cache;
+    if (cache.Open(cachePath.c_str())) {
+        if (cache.size == cacheBytes && !memcmp(cache.data, &header, sizeof(header))) {
+            memcpy(data->glyphs, cache.data + sizeof(header), sizeof(data->glyphs));
+            atlas = cache.data + sizeof(header) + sizeof(data->glyphs);
+        } else {
+            cache.Close();
+        }
+    }
 
-    VkMemoryRequirements mem_reqs;
-    pTable->GetImageMemoryRequirements(device, data->fontGlyphsImage, &mem_reqs);
+    if (!atlas) {
+        baked.resize(atlasBytes);
+        stbtt_BakeFontBitmap(&fontData[0], 0, FONT_SIZE_PIXELS, baked.data(), FONT_ATLAS_SIZE, FONT_ATLAS_SIZE, 32, 96, data->glyphs);
+        baked[atlasBytes - 1] = 0xff;
+
+        write_glyph_cache(cachePath, header, data->glyphs, baked);
+        atlas = baked.data();
+    }
+
+    /* Upload the font bitmap through a staging buffer */
+    VkBufferCreateInfo bci;
+    memset(&bci, 0, sizeof(bci));
+    bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bci.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bci.size = atlasBytes;
+
+    err = pTable->CreateBuffer(device, &bci, nullptr, &data->fontStagingBuffer);
+    assert(!err);
+
+    VkMemoryRequirements mem_reqs;
+    pTable->GetBufferMemoryRequirements(device, data->fontStagingBuffer, &mem_reqs);
 
     VkMemoryAllocateInfo mem_alloc;
     memset(&mem_alloc, 0, sizeof(mem_alloc));
@@ -312,35 +1238,46 @@ static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_dat
     mem_alloc.memoryTypeIndex = choose_memory_type(gpu, mem_reqs.memoryTypeBits,
                                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-    err = pTable->AllocateMemory(device, &mem_alloc, nullptr, &data->fontGlyphsMemory);
+    err = pTable->AllocateMemory(device, &mem_alloc, nullptr, &data->fontStagingMemory);
     assert(!err);
-    err = pTable->BindImageMemory(device, data->fontGlyphsImage, data->fontGlyphsMemory, 0);
+    err = pTable->BindBufferMemory(device, data->fontStagingBuffer, data->fontStagingMemory, 0);
     assert(!err);
 
-    VkImageSubresource subres;
-    subres.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subres.mipLevel = 0;
-    subres.arrayLayer = 0;
-    VkSubresourceLayout layout;
     void *bits;
+    err = pTable->MapMemory(device, data->fontStagingMemory, 0, VK_WHOLE_SIZE, 0, &bits);
+    assert(!err);
+    memcpy(bits, atlas, atlasBytes);
+    pTable->UnmapMemory(device, data->fontStagingMemory);
 
-    pTable->GetImageSubresourceLayout(device, data->fontGlyphsImage, &subres, &layout);
+    cache.Close();
 
-    /* ensure we can directly upload into this layout */
-    assert(!layout.offset);
-    assert(layout.size >= FONT_ATLAS_SIZE * FONT_ATLAS_SIZE);
-    assert(layout.rowPitch == FONT_ATLAS_SIZE);
+    VkImageCreateInfo ici;
+    memset(&ici, 0, sizeof(ici));
+    ici.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    ici.imageType = VK_IMAGE_TYPE_2D;
+    ici.format = VK_FORMAT_R8_UNORM;
+    ici.extent.width = FONT_ATLAS_SIZE;
+    ici.extent.height = FONT_ATLAS_SIZE;
+    ici.extent.depth = 1;
+    ici.mipLevels = 1;
+    ici.arrayLayers = 1;
+    ici.samples = VK_SAMPLE_COUNT_1_BIT;
+    ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ici.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-    err = pTable->MapMemory(device, data->fontGlyphsMemory, 0, VK_WHOLE_SIZE, 0, &bits);
+    err = pTable->CreateImage(device, &ici, nullptr, &data->fontGlyphsImage);
     assert(!err);
 
-    /* Load the font glyphs directly into the mapped buffer */
-    std::vector<unsigned char> fontData;
-    get_file_contents(VULKAN_SAMPLES_BASE_DIR "/Layer-Samples/data/FreeSans.ttf", fontData);
-    stbtt_BakeFontBitmap(&fontData[0], 0, FONT_SIZE_PIXELS, (unsigned char *)bits, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE, 32, 96,
-                         data->glyphs);
+    pTable->GetImageMemoryRequirements(device, data->fontGlyphsImage, &mem_reqs);
 
-    pTable->UnmapMemory(device, data->fontGlyphsMemory);
+    mem_alloc.allocationSize = mem_reqs.size;
+    mem_alloc.memoryTypeIndex = choose_memory_type(gpu, mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    err = pTable->AllocateMemory(device, &mem_alloc, nullptr, &data->fontGlyphsMemory);
+    assert(!err);
+    err = pTable->BindImageMemory(device, data->fontGlyphsImage, data->fontGlyphsMemory, 0);
+    assert(!err);
 
     VkImageViewCreateInfo ivci;
     ivci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -362,7 +1299,7 @@ static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_dat
     err = pTable->CreateImageView(device, &ivci, nullptr, &data->fontGlyphsImageView);
     assert(!err);
 
-    /* transition from undefined layout to shader readonly so we can use it.
+    /* copy into the image and transition it to shader readonly so we can use it.
      * requires a command buffer. */
     VkCommandBufferAllocateInfo cbai;
     cbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -399,30 +1336,74 @@ static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_dat
     VkImageMemoryBarrier imb;
     imb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     imb.pNext = nullptr;
-    imb.dstAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    imb.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
     imb.srcAccessMask = 0;
     imb.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imb.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imb.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     imb.image = data->fontGlyphsImage;
     imb.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     imb.subresourceRange.baseMipLevel = 0;
     imb.subresourceRange.levelCount = 1;
     imb.subresourceRange.baseArrayLayer = 0;
     imb.subresourceRange.layerCount = 1;
-    imb.srcQueueFamilyIndex = data->graphicsQueueFamilyIndex;
-    imb.dstQueueFamilyIndex = data->graphicsQueueFamilyIndex;
+    imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-    pTable->CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0 /* dependency flags */,
+    pTable->CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0 /* dependency flags */,
+                               0, nullptr, /* memory barriers */
+                               0, nullptr, /* buffer memory barriers */
+                               1, &imb);   /* image memory barriers */
+
+    VkBufferImageCopy region;
+    memset(&region, 0, sizeof(region));
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = FONT_ATLAS_SIZE;
+    region.imageExtent.height = FONT_ATLAS_SIZE;
+    region.imageExtent.depth = 1;
+
+    pTable->CmdCopyBufferToImage(cmd, data->fontStagingBuffer, data->fontGlyphsImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    imb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imb.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    pTable->CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0 /* dependency flags */,
                                0, nullptr, /* memory barriers */
                                0, nullptr, /* buffer memory barriers */
                                1, &imb);   /* image memory barriers */
 
     pTable->EndCommandBuffer(cmd);
     data->fontUploadCmdBuffer = cmd;
-    data->fontUploadComplete = false; /* we will schedule this at first present on this device */
+
+    VkFenceCreateInfo fci;
+    fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fci.pNext = nullptr;
+    fci.flags = 0;
+    err = pTable->CreateFence(device, &fci, nullptr, &data->fontUploadFence);
+    assert(!err);
+
+    /* the app cannot use the device yet, so submitting on its first graphics queue is safe. without one the upload
+     * waits for the first present */
+    data->fontUploadSubmitted = false;
+    if (data->hasGraphicsQueue) {
+        VkQueue queue;
+        pTable->GetDeviceQueue(device, data->graphicsQueueFamilyIndex, 0, &queue);
+
+        /* a queue fetched below the loader has no dispatch table either */
+        if (!data->pfn_dev_init) {
+            *((const void **)queue) = *(void **)device;
+        } else {
+            err = data->pfn_dev_init(device, (void *)queue);
+            assert(!err);
+        }
+
+        submit_font_upload(data, queue);
+    }
 
 #ifdef OVERLAY_DEBUG
-    printf("Font upload done.\n");
+    printf("Font upload queued.\n");
 #endif
 
     /* create a sampler to use with the texture */
@@ -502,7 +1483,7 @@ static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_dat
     VkDescriptorImageInfo descs[1];
     descs[0].sampler = data->sampler;
     descs[0].imageView = data->fontGlyphsImageView;
-    descs[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;  // TODO: cube does this, is it correct?
+    descs[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     VkWriteDescriptorSet writes[1];
     memset(&writes, 0, sizeof(writes));
@@ -515,15 +1496,96 @@ static void after_device_create(VkPhysicalDevice gpu, VkDevice device, layer_dat
 
     pTable->UpdateDescriptorSets(device, 1, writes, 0, nullptr);
 
-    VkFenceCreateInfo fci;
-    fci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fci.pNext = NULL;
-    fci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    pTable->CreateFence(device, &fci, NULL, &data->fence);
+    layer_data *instance_data = get_layer_data(get_dispatch_key(gpu));
+    VkPhysicalDeviceProperties props;
+    instance_data->instance_dispatch_table->GetPhysicalDeviceProperties(gpu, &props);
+    data->timestampPeriod = props.limits.timestampPeriod;
+
+    /* memory tracking */
+    instance_data->instance_dispatch_table->GetPhysicalDeviceMemoryProperties(gpu, &data->memoryProps);
+    data->maxMemoryAllocationCount = props.limits.maxMemoryAllocationCount;
+    memset(data->heapAllocated, 0, sizeof(data->heapAllocated));
+    memset(data->heapBound, 0, sizeof(data->heapBound));
+    memset(data->typeAllocated, 0, sizeof(data->typeAllocated));
+    memset(data->typeAllocations, 0, sizeof(data->typeAllocations));
+    memset(data->allocationHistogram, 0, sizeof(data->allocationHistogram));
+    data->smallAllocations = 0;
+
+    VkFenceCreateInfo ofci;
+    ofci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    ofci.pNext = nullptr;
+    ofci.flags = 0;
+
+    VkSemaphoreCreateInfo osci;
+    osci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    osci.pNext = nullptr;
+    osci.flags = 0;
+
+    for (auto &os : data->overlaySubmits) {
+        err = pTable->CreateFence(device, &ofci, nullptr, &os.fence);
+        assert(!err);
+        err = pTable->CreateSemaphore(device, &osci, nullptr, &os.semaphore);
+        assert(!err);
+        os.serial = 0;
+    }
+    data->presentSerial = 0;
+
+    /* timestamp queries, a begin/end pair per frame */
+    data->timestampPool = VK_NULL_HANDLE;
+    if (data->timestampMask) {
+        VkQueryPoolCreateInfo qpci;
+        memset(&qpci, 0, sizeof(qpci));
+        qpci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        qpci.queryCount = TIMESTAMP_FRAMES * 2;
+        err = pTable->CreateQueryPool(device, &qpci, nullptr, &data->timestampPool);
+        assert(!err);
+
+        /* the begin half is only recorded again when the stage it is written at changes */
+        cbai.commandBufferCount = TIMESTAMP_FRAMES;
+        err = pTable->AllocateCommandBuffers(device, &cbai, data->timestampCmds);
+        assert(!err);
+
+        for (uint32_t i = 0; i < TIMESTAMP_FRAMES; i++) {
+            VkCommandBuffer tcmd = data->timestampCmds[i];
+            if (!data->pfn_dev_init) {
+                *((const void **)tcmd) = *(void **)device;
+            } else {
+                err = data->pfn_dev_init(device, (void *)tcmd);
+                assert(!err);
+            }
+
+            record_frame_begin(data, i, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+            data->timestampPending[i] = false;
+        }
+    }
+
+    /* submit instrumentation, configured from the environment */
+    const char *queueTiming = getenv("VK_OVERLAY_QUEUE_TIMING");
+    data->queueTiming = queueTiming && strcmp(queueTiming, "0");
+
+    data->startTime = std::chrono::steady_clock::now();
+    data->traceFile = nullptr;
+
+    const char *traceName = getenv("VK_OVERLAY_TRACE_FILE");
+    if (traceName && *traceName) {
+        size_t len = strlen(traceName);
+        data->traceJson = len >= 5 && !strcmp(traceName + len - 5, ".json");
+        data->traceEmpty = true;
+
+        data->traceFile = fopen(traceName, "w");
+        if (data->traceFile) {
+            fputs(data->traceJson ? "[\n"
+                                  : "frame,queue_family,queue_index,cpu_us,command_buffers,wait_semaphores,signal_semaphores,"
+                                    "draws,pipeline_binds,descriptor_binds,push_constants,gpu_begin_us,gpu_end_us\n",
+                  data->traceFile);
+        }
+    }
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
                                                               const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
+    API_TRACE(CreateDevice);
     VkLayerDeviceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
 
     assert(chain_info->u.pLayerInfo);
@@ -537,12 +1599,34 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice g
     // Advance the link info for the next element on the chain
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
 
-    VkResult result = fpCreateDevice(gpu, pCreateInfo, pAllocator, pDevice);
+    /* enable VK_EXT_memory_budget for the memory stats when the driver has it */
+    layer_data *my_data = get_layer_data(get_dispatch_key(gpu));
+    std::vector<const char *> extensions(pCreateInfo->ppEnabledExtensionNames,
+                                         pCreateInfo->ppEnabledExtensionNames + pCreateInfo->enabledExtensionCount);
+    bool memoryBudget = false;
+    if (my_data->pfnGetPhysicalDeviceMemoryProperties2) {
+        uint32_t count = 0;
+        my_data->instance_dispatch_table->EnumerateDeviceExtensionProperties(gpu, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> props(count);
+        my_data->instance_dispatch_table->EnumerateDeviceExtensionProperties(gpu, nullptr, &count, props.data());
+
+        for (auto &ext : props) memoryBudget |= !strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+        bool enabled = false;
+        for (auto ext : extensions) enabled |= !strcmp(ext, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (memoryBudget && !enabled) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    VkDeviceCreateInfo dci = *pCreateInfo;
+    dci.enabledExtensionCount = (uint32_t)extensions.size();
+    dci.ppEnabledExtensionNames = extensions.data();
+
+    VkResult result = fpCreateDevice(gpu, &dci, pAllocator, pDevice);
     if (result != VK_SUCCESS) {
         return result;
     }
 
-    layer_data *my_device_data = GetLayerDataPtr(get_dispatch_key(*pDevice), layer_data_map);
+    layer_data *my_device_data = add_layer_data(get_dispatch_key(*pDevice));
 
     // Setup device dispatch table
     my_device_data->device_dispatch_table = new VkLayerDispatchTable;
@@ -556,21 +1640,27 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice g
         my_device_data->pfn_dev_init = NULL;
     }
 
+    my_device_data->memoryBudget = memoryBudget;
+
     uint32_t queue_family_count;
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(gpu), layer_data_map);
     my_data->instance_dispatch_table->GetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, NULL);
     VkQueueFamilyProperties *queue_props = (VkQueueFamilyProperties *)malloc(queue_family_count * sizeof(VkQueueFamilyProperties));
     if (queue_props == NULL) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
     my_data->instance_dispatch_table->GetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, queue_props);
-    my_device_data->graphicsQueueFamilyIndex = 0;
+    my_device_data->graphicsQueueFamilyIndex = pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex;
+    my_device_data->hasGraphicsQueue = false;
     for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++) {
         if (queue_props[pCreateInfo->pQueueCreateInfos[i].queueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             my_device_data->graphicsQueueFamilyIndex = pCreateInfo->pQueueCreateInfos[i].queueFamilyIndex;
+            my_device_data->hasGraphicsQueue = true;
             break;
         }
     }
+    uint32_t timestampBits = queue_props[my_device_data->graphicsQueueFamilyIndex].timestampValidBits;
+    my_device_data->timestampMask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+    my_device_data->queueFamilyProps.assign(queue_props, queue_props + queue_family_count);
     free(queue_props);
 
     after_device_create(gpu, *pDevice, my_device_data);
@@ -578,24 +1668,30 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice g
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {
+    API_TRACE(DestroyDevice);
     dispatch_key key = get_dispatch_key(device);
-    layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
-    my_data->Cleanup();
+    layer_data *my_data = get_layer_data(key);
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     pTable->DeviceWaitIdle(device);
+    my_data->Cleanup();
     pTable->DestroyDevice(device, pAllocator);
     delete pTable;
-    layer_data_map.erase(key);
+    remove_layer_data(key);
+    cmd_stats_epoch.fetch_add(1, std::memory_order_release);
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
                                                                 const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
+    begin_api_trace();
+    API_TRACE(CreateInstance);
+
     VkLayerInstanceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
 
     assert(chain_info->u.pLayerInfo);
     PFN_vkGetInstanceProcAddr fpGetInstanceProcAddr = chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
     PFN_vkCreateInstance fpCreateInstance = (PFN_vkCreateInstance)fpGetInstanceProcAddr(NULL, "vkCreateInstance");
     if (fpCreateInstance == NULL) {
+        end_api_trace();
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
@@ -603,35 +1699,58 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstance
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
 
     VkResult result = fpCreateInstance(pCreateInfo, pAllocator, pInstance);
-    if (result != VK_SUCCESS) return result;
+    if (result != VK_SUCCESS) {
+        end_api_trace();
+        return result;
+    }
 
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(*pInstance), layer_data_map);
+    layer_data *my_data = add_layer_data(get_dispatch_key(*pInstance));
     my_data->instance_dispatch_table = new VkLayerInstanceDispatchTable;
     layer_init_instance_dispatch_table(*pInstance, my_data->instance_dispatch_table, fpGetInstanceProcAddr);
 
-    init_overlay(my_data);
+    /* memory budget queries need vkGetPhysicalDeviceMemoryProperties2, from 1.1 or the KHR extension */
+    my_data->pfnGetPhysicalDeviceMemoryProperties2 = nullptr;
+    if (pCreateInfo->pApplicationInfo && pCreateInfo->pApplicationInfo->apiVersion >= VK_API_VERSION_1_1) {
+        my_data->pfnGetPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)fpGetInstanceProcAddr(
+            *pInstance, "vkGetPhysicalDeviceMemoryProperties2");
+    }
+    for (uint32_t i = 0; i < pCreateInfo->enabledExtensionCount && !my_data->pfnGetPhysicalDeviceMemoryProperties2; i++) {
+        if (!strcmp(pCreateInfo->ppEnabledExtensionNames[i], VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+            my_data->pfnGetPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)fpGetInstanceProcAddr(
+                *pInstance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        }
+    }
+
     return result;
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {
+    API_TRACE(DestroyInstance);
     dispatch_key key = get_dispatch_key(instance);
-    layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
+    layer_data *my_data = get_layer_data(key);
     VkLayerInstanceDispatchTable *pTable = my_data->instance_dispatch_table;
     pTable->DestroyInstance(instance, pAllocator);
     delete pTable;
-    layer_data_map.erase(key);
+    remove_layer_data(key);
+
+    end_api_trace();
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pCreateInfo,
                                                                     const VkAllocationCallbacks *pAllocator,
                                                                     VkSwapchainKHR *pSwapChain) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    API_TRACE(CreateSwapchainKHR);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     VkResult result = my_data->pfnCreateSwapchainKHR(device, pCreateInfo, pAllocator, pSwapChain);
 
     if (result == VK_SUCCESS) {
-        auto &data = (*my_data->swapChains)[*pSwapChain];
-        data = new SwapChainData;
+        auto data = new SwapChainData;
+
+        loader_platform_thread_lock_mutex(&my_data->lock);
+        (*my_data->swapChains)[*pSwapChain] = data;
+        loader_platform_thread_unlock_mutex(&my_data->lock);
+
         data->width = pCreateInfo->imageExtent.width;
         data->height = pCreateInfo->imageExtent.height;
         data->format = pCreateInfo->imageFormat;
@@ -716,7 +1835,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice dev
         VkPipelineInputAssemblyStateCreateInfo piasci;
         memset(&piasci, 0, sizeof(piasci));
         piasci.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        piasci.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        piasci.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
 
         VkViewport viewport;
         memset(&viewport, 0, sizeof(viewport));
@@ -772,11 +1891,12 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice dev
         pcbsci.blendConstants[3] = 1.0f;
 
         VkVertexInputBindingDescription bindings[] = {
-            {0, sizeof(vertex), VK_VERTEX_INPUT_RATE_VERTEX},
+            {0, sizeof(glyph_instance), VK_VERTEX_INPUT_RATE_INSTANCE},
         };
 
         VkVertexInputAttributeDescription attribs[] = {
-            {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(vertex, x)}, {1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(vertex, u)},
+            {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(glyph_instance, x0)},
+            {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(glyph_instance, s0)},
         };
 
         VkPipelineVertexInputStateCreateInfo pvisci;
@@ -817,7 +1937,8 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice dev
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapChain, uint32_t *pCount,
                                                                        VkImage *pImages) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    API_TRACE(GetSwapchainImagesKHR);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     VkResult result = my_data->pfnGetSwapchainImagesKHR(device, swapChain, pCount, pImages);
     VkResult U_ASSERT_ONLY err;
@@ -829,7 +1950,9 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice
      * /actual/ fetch of the images.
      */
     if (pImages) {
+        loader_platform_thread_lock_mutex(&my_data->lock);
         auto data = (*my_data->swapChains)[swapChain];
+        loader_platform_thread_unlock_mutex(&my_data->lock);
 
         for (uint32_t i = 0; i < *pCount; i++) {
             /* Create attachment view for each */
@@ -877,7 +2000,9 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice
             cbai.commandBufferCount = 1;
 
             VkCommandBuffer cmd;
+            my_data->presentLock.lock();
             pTable->AllocateCommandBuffers(device, &cbai, &cmd);
+            my_data->presentLock.unlock();
 
             /* We have just created a dispatchable object, but the dispatch
              * table has not been placed in the object yet.
@@ -898,7 +2023,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice
             memset(&bci, 0, sizeof(bci));
             bci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
             bci.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-            bci.size = sizeof(vertex) * MAX_TEXT_VERTICES;
+            bci.size = sizeof(glyph_instance) * MAX_GLYPHS;
 
             VkBuffer buf;
             err = pTable->CreateBuffer(device, &bci, nullptr, &buf);
@@ -927,10 +2052,18 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice
             imageData->view = v;
             imageData->framebuffer = fb;
             imageData->cmd = cmd;
+            imageData->submitSerial = 0;
             imageData->vertexBuffer = buf;
             imageData->vertexBufferMemory = mem;
-            imageData->numVertices = 0;
-            imageData->vertexBufferSize = mem_alloc.allocationSize;
+            imageData->numGlyphs = 0;
+            imageData->numStableGlyphs = 0;
+            my_data->presentLock.lock();
+            imageData->stableVersion = my_data->stableText.version - 1;
+            my_data->presentLock.unlock();
+
+            /* stays mapped for the life of the image */
+            err = pTable->MapMemory(device, mem, 0, VK_WHOLE_SIZE, 0, (void **)&imageData->mappedGlyphs);
+            assert(!err);
 
             data->presentableImages.push_back(imageData);
         }
@@ -938,50 +2071,663 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice
     return result;
 }
 
-VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits,
-                                                             VkFence fence) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+                                                                const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory) {
+    API_TRACE(AllocateMemory);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+    VkResult result = my_data->device_dispatch_table->AllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+    if (result != VK_SUCCESS) return result;
+
+    MemoryAllocation alloc;
+    alloc.type = pAllocateInfo->memoryTypeIndex;
+    alloc.size = pAllocateInfo->allocationSize;
+    alloc.boundSize = 0;
+
+    loader_platform_thread_lock_mutex(&my_data->lock);
+    my_data->allocations[*pMemory] = alloc;
+    my_data->heapAllocated[my_data->memoryProps.memoryTypes[alloc.type].heapIndex] += alloc.size;
+    my_data->typeAllocated[alloc.type] += alloc.size;
+    my_data->typeAllocations[alloc.type]++;
+    my_data->allocationHistogram[memory_histogram_bucket(alloc.size)]++;
+    if (alloc.size < SMALL_ALLOCATION_SIZE) my_data->smallAllocations++;
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAllocator) {
+    API_TRACE(FreeMemory);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+
+    loader_platform_thread_lock_mutex(&my_data->lock);
+    auto it = my_data->allocations.find(memory);
+    if (it != my_data->allocations.end()) {
+        const MemoryAllocation &alloc = it->second;
+        my_data->heapAllocated[my_data->memoryProps.memoryTypes[alloc.type].heapIndex] -= alloc.size;
+        my_data->heapBound[my_data->memoryProps.memoryTypes[alloc.type].heapIndex] -= alloc.boundSize;
+        my_data->typeAllocated[alloc.type] -= alloc.size;
+        my_data->typeAllocations[alloc.type]--;
+        my_data->allocationHistogram[memory_histogram_bucket(alloc.size)]--;
+        if (alloc.size < SMALL_ALLOCATION_SIZE) my_data->smallAllocations--;
+        my_data->allocations.erase(it);
+    }
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+
+    my_data->device_dispatch_table->FreeMemory(device, memory, pAllocator);
+}
+
+/* binding tracking, called with the device lock held */
+static void track_binding(layer_data *my_data, const MemoryBinding &binding) {
+    auto it = my_data->allocations.find(binding.memory);
+    if (it == my_data->allocations.end()) return;
+
+    it->second.boundSize += binding.size;
+    my_data->heapBound[my_data->memoryProps.memoryTypes[it->second.type].heapIndex] += binding.size;
+}
+
+static void untrack_binding(layer_data *my_data, const MemoryBinding &binding) {
+    /* freeing the memory first already dropped its bound bytes */
+    auto it = my_data->allocations.find(binding.memory);
+    if (it == my_data->allocations.end()) return;
+
+    VkDeviceSize size = std::min(binding.size, it->second.boundSize);
+    it->second.boundSize -= size;
+    my_data->heapBound[my_data->memoryProps.memoryTypes[it->second.type].heapIndex] -= size;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory,
+                                                                  VkDeviceSize memoryOffset) {
+    API_TRACE(BindBufferMemory);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+    VkResult result = my_data->device_dispatch_table->BindBufferMemory(device, buffer, memory, memoryOffset);
+    if (result != VK_SUCCESS) return result;
+
+    VkMemoryRequirements reqs;
+    my_data->device_dispatch_table->GetBufferMemoryRequirements(device, buffer, &reqs);
+
+    MemoryBinding binding;
+    binding.memory = memory;
+    binding.size = reqs.size;
+
+    loader_platform_thread_lock_mutex(&my_data->lock);
+    my_data->bufferBindings[buffer] = binding;
+    track_binding(my_data, binding);
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory,
+                                                                 VkDeviceSize memoryOffset) {
+    API_TRACE(BindImageMemory);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+    VkResult result = my_data->device_dispatch_table->BindImageMemory(device, image, memory, memoryOffset);
+    if (result != VK_SUCCESS) return result;
+
+    VkMemoryRequirements reqs;
+    my_data->device_dispatch_table->GetImageMemoryRequirements(device, image, &reqs);
+
+    MemoryBinding binding;
+    binding.memory = memory;
+    binding.size = reqs.size;
+
+    loader_platform_thread_lock_mutex(&my_data->lock);
+    my_data->imageBindings[image] = binding;
+    track_binding(my_data, binding);
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAllocator) {
+    API_TRACE(DestroyBuffer);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+
+    loader_platform_thread_lock_mutex(&my_data->lock);
+    auto it = my_data->bufferBindings.find(buffer);
+    if (it != my_data->bufferBindings.end()) {
+        untrack_binding(my_data, it->second);
+        my_data->bufferBindings.erase(it);
+    }
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+
+    my_data->device_dispatch_table->DestroyBuffer(device, buffer, pAllocator);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator) {
+    API_TRACE(DestroyImage);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+
+    loader_platform_thread_lock_mutex(&my_data->lock);
+    auto it = my_data->imageBindings.find(image);
+    if (it != my_data->imageBindings.end()) {
+        untrack_binding(my_data, it->second);
+        my_data->imageBindings.erase(it);
+    }
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+
+    my_data->device_dispatch_table->DestroyImage(device, image, pAllocator);
+}
+
+static QueueData *create_queue_data(layer_data *my_data, uint32_t family, uint32_t index) {
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkResult U_ASSERT_ONLY err;
+
+    QueueData *qd = new QueueData;
+    qd->family = family;
+    qd->index = index;
+    qd->batches = qd->commandBuffers = qd->waitSemaphores = qd->signalSemaphores = 0;
+    qd->pool = VK_NULL_HANDLE;
+    qd->timestampPool = VK_NULL_HANDLE;
+    qd->oldest = qd->pending = 0;
+
+    /* queries can only be reset on graphics or compute queues */
+    const VkQueueFamilyProperties &props = my_data->queueFamilyProps[family];
+    if (!my_data->queueTiming || !props.timestampValidBits || !(props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        return qd;
+
+    qd->timestampMask = props.timestampValidBits >= 64 ? ~0ull : (1ull << props.timestampValidBits) - 1;
+
+    VkCommandPoolCreateInfo cpci;
+    cpci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cpci.pNext = nullptr;
+    cpci.queueFamilyIndex = family;
+    cpci.flags = 0;
+    err = pTable->CreateCommandPool(my_data->dev, &cpci, nullptr, &qd->pool);
+    assert(!err);
 
-    my_data->cmdBuffersThisFrame += submitCount;  // XXX WRONG
+    VkQueryPoolCreateInfo qpci;
+    memset(&qpci, 0, sizeof(qpci));
+    qpci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    qpci.queryCount = SUBMIT_TIMESTAMP_SLOTS * 2;
+    err = pTable->CreateQueryPool(my_data->dev, &qpci, nullptr, &qd->timestampPool);
+    assert(!err);
 
-    return pTable->QueueSubmit(queue, submitCount, pSubmits, fence);
+    VkCommandBufferAllocateInfo cbai;
+    cbai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cbai.pNext = nullptr;
+    cbai.commandPool = qd->pool;
+    cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cbai.commandBufferCount = SUBMIT_TIMESTAMP_SLOTS;
+    err = pTable->AllocateCommandBuffers(my_data->dev, &cbai, qd->beginCmds);
+    assert(!err);
+    err = pTable->AllocateCommandBuffers(my_data->dev, &cbai, qd->endCmds);
+    assert(!err);
+
+    VkCommandBufferBeginInfo cbbi;
+    cbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cbbi.pNext = nullptr;
+    cbbi.flags = 0;
+    cbbi.pInheritanceInfo = nullptr;
+
+    for (uint32_t i = 0; i < SUBMIT_TIMESTAMP_SLOTS; i++) {
+        VkCommandBuffer cmds[] = {qd->beginCmds[i], qd->endCmds[i]};
+        for (auto cmd : cmds) {
+            if (!my_data->pfn_dev_init) {
+                *((const void **)cmd) = *(void **)my_data->dev;
+            } else {
+                err = my_data->pfn_dev_init(my_data->dev, (void *)cmd);
+                assert(!err);
+            }
+        }
+
+        pTable->BeginCommandBuffer(qd->beginCmds[i], &cbbi);
+        pTable->CmdResetQueryPool(qd->beginCmds[i], qd->timestampPool, i * 2, 2);
+        pTable->CmdWriteTimestamp(qd->beginCmds[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, qd->timestampPool, i * 2);
+        pTable->EndCommandBuffer(qd->beginCmds[i]);
+
+        pTable->BeginCommandBuffer(qd->endCmds[i], &cbbi);
+        pTable->CmdWriteTimestamp(qd->endCmds[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, qd->timestampPool, i * 2 + 1);
+        pTable->EndCommandBuffer(qd->endCmds[i]);
+    }
+
+    return qd;
+}
+
+/* gpu times are in microseconds, or negative for batches that were not timed */
+static void queue_submit_record(layer_data *my_data, const QueueData *qd, const SubmitRecord &rec, double gpuBegin, double gpuEnd) {
+    if (!my_data->traceFile) return;
+
+    TraceEntry entry;
+    entry.rec = rec;
+    entry.family = qd->family;
+    entry.index = qd->index;
+    entry.gpuBegin = gpuBegin;
+    entry.gpuEnd = gpuEnd;
+
+    std::lock_guard<std::mutex> lock(my_data->traceQueuedLock);
+    my_data->traceQueued.push_back(entry);
 }
 
-static void before_present(VkQueue queue, layer_data *my_data, SwapChainData *swapChain, unsigned imageIndex) {
+/* writes out traceWriting, called with traceLock held */
+static void write_submit_records(layer_data *my_data) {
+    FILE *f = my_data->traceFile;
+
+    for (auto &entry : my_data->traceWriting) {
+        const SubmitRecord &rec = entry.rec;
+        if (my_data->traceJson) {
+            fprintf(f,
+                    "%s  {\"frame\": %d, \"queue_family\": %u, \"queue_index\": %u, \"cpu_us\": %.1f, \"command_buffers\": %u, "
+                    "\"wait_semaphores\": %u, \"signal_semaphores\": %u, \"draws\": %u, \"pipeline_binds\": %u, "
+                    "\"descriptor_binds\": %u, \"push_constants\": %u",
+                    my_data->traceEmpty ? "" : ",\n", rec.frame, entry.family, entry.index, rec.cpuTimeUs, rec.commandBuffers,
+                    rec.waitSemaphores, rec.signalSemaphores, rec.draws, rec.pipelineBinds, rec.descriptorBinds, rec.pushConstants);
+            if (entry.gpuBegin >= 0.0) fprintf(f, ", \"gpu_begin_us\": %.3f, \"gpu_end_us\": %.3f", entry.gpuBegin, entry.gpuEnd);
+            fputs("}", f);
+        } else {
+            fprintf(f, "%d,%u,%u,%.1f,%u,%u,%u,%u,%u,%u,%u,", rec.frame, entry.family, entry.index, rec.cpuTimeUs, rec.commandBuffers,
+                    rec.waitSemaphores, rec.signalSemaphores, rec.draws, rec.pipelineBinds, rec.descriptorBinds, rec.pushConstants);
+            /* untimed batches leave both gpu columns empty */
+            if (entry.gpuBegin >= 0.0) {
+                fprintf(f, "%.3f,%.3f\n", entry.gpuBegin, entry.gpuEnd);
+            } else {
+                fputs(",\n", f);
+            }
+        }
+
+        my_data->traceEmpty = false;
+    }
+
+    my_data->traceWriting.clear();
+}
+
+/* retires timed batches of the queue that have finished, oldest first, called with the queue's lock held */
+static void collect_submit_times(layer_data *my_data, QueueData *qd) {
+    while (qd->pending) {
+        uint32_t slot = qd->oldest;
+
+        uint64_t ts[2];
+        VkResult res = my_data->device_dispatch_table->GetQueryPoolResults(my_data->dev, qd->timestampPool, slot * 2, 2, sizeof(ts), ts,
+                                                                            sizeof(ts[0]), VK_QUERY_RESULT_64_BIT);
+        if (res != VK_SUCCESS) break;
+
+        double begin = (ts[0] & qd->timestampMask) * (double)my_data->timestampPeriod;
+        double end = begin + ((ts[1] - ts[0]) & qd->timestampMask) * (double)my_data->timestampPeriod;
+
+        if (!qd->busy.empty() && begin <= qd->busy.back().second) {
+            qd->busy.back().second = std::max(qd->busy.back().second, end);
+        } else {
+            qd->busy.push_back(std::make_pair(begin, end));
+        }
+        while (qd->busy.front().second < qd->busy.back().second - QUEUE_BUSY_WINDOW_NS) qd->busy.pop_front();
+
+        queue_submit_record(my_data, qd, qd->records[slot], begin / 1000.0, end / 1000.0);
+
+        qd->oldest = (slot + 1) % SUBMIT_TIMESTAMP_SLOTS;
+        qd->pending--;
+    }
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex,
+                                                            VkQueue *pQueue) {
+    API_TRACE(GetDeviceQueue);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+    my_data->device_dispatch_table->GetDeviceQueue(device, queueFamilyIndex, queueIndex, pQueue);
+
+    loader_platform_thread_lock_mutex(&my_data->lock);
+    QueueMap *queues = my_data->queues.load(std::memory_order_relaxed);
+    if (!queues->count(*pQueue)) {
+        QueueMap *published = new QueueMap(*queues);
+        (*published)[*pQueue] = create_queue_data(my_data, queueFamilyIndex, queueIndex);
+        my_data->queues.store(published, std::memory_order_release);
+        my_data->retiredQueueMaps.push_back(queues);
+    }
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+}
+
+/* The command buffer this thread last recorded into. Command buffers are
+ * externally synchronized, so the recording thread can bump its counters
+ * without the device lock; the app's own synchronization orders that before
+ * the submit that reads them. The handle may be freed and handed out again,
+ * or its device destroyed, so the cache only holds while cmd_stats_epoch is
+ * unchanged.
+ */
+static thread_local VkCommandBuffer tls_cmd = VK_NULL_HANDLE;
+static thread_local CommandBufferStats *tls_stats = nullptr;
+static thread_local uint64_t tls_cmd_epoch;
+
+static CommandBufferStats *get_cmd_stats(VkCommandBuffer commandBuffer) {
+    uint64_t epoch = cmd_stats_epoch.load(std::memory_order_acquire);
+    if (commandBuffer == tls_cmd && epoch == tls_cmd_epoch) return tls_stats;
+
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+
+    my_data->cmdStatsLock.lock();
+    CommandBufferStats *stats = &my_data->cmdBufferStats[commandBuffer];
+    my_data->cmdStatsLock.unlock();
+
+    tls_cmd = commandBuffer;
+    tls_stats = stats;
+    tls_cmd_epoch = epoch;
+    return stats;
+}
+
+static void reset_cmd_stats(CommandBufferStats *stats) {
+    stats->draws = 0;
+    stats->pipelineBinds = 0;
+    stats->descriptorBinds = 0;
+    stats->pushConstants = 0;
+    stats->secondaries.clear();
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+                                                                    const VkCommandBufferBeginInfo *pBeginInfo) {
+    API_TRACE(BeginCommandBuffer);
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+
+    /* implicitly resets the command buffer */
+    reset_cmd_stats(get_cmd_stats(commandBuffer));
+
+    return my_data->device_dispatch_table->BeginCommandBuffer(commandBuffer, pBeginInfo);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool,
+                                                                uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers) {
+    API_TRACE(FreeCommandBuffers);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+
+    my_data->cmdStatsLock.lock();
+    for (uint32_t i = 0; i < commandBufferCount; i++) my_data->cmdBufferStats.erase(pCommandBuffers[i]);
+    cmd_stats_epoch.fetch_add(1, std::memory_order_release);
+    my_data->cmdStatsLock.unlock();
+
+    my_data->device_dispatch_table->FreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+                                                                        VkCommandBuffer *pCommandBuffers) {
+    API_TRACE(AllocateCommandBuffers);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+    VkResult result = my_data->device_dispatch_table->AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+    if (result != VK_SUCCESS) return result;
+
+    /* remembered so that destroying the pool can erase the stats */
+    my_data->cmdStatsLock.lock();
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+        CommandBufferStats &stats = my_data->cmdBufferStats[pCommandBuffers[i]];
+        reset_cmd_stats(&stats);
+        stats.pool = pAllocateInfo->commandPool;
+    }
+    my_data->cmdStatsLock.unlock();
+
+    return result;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+                                                                const VkAllocationCallbacks *pAllocator) {
+    API_TRACE(DestroyCommandPool);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
+
+    /* frees the command buffers still allocated from the pool */
+    my_data->cmdStatsLock.lock();
+    for (auto it = my_data->cmdBufferStats.begin(); it != my_data->cmdBufferStats.end();) {
+        if (it->second.pool == commandPool)
+            it = my_data->cmdBufferStats.erase(it);
+        else
+            ++it;
+    }
+    cmd_stats_epoch.fetch_add(1, std::memory_order_release);
+    my_data->cmdStatsLock.unlock();
+
+    my_data->device_dispatch_table->DestroyCommandPool(device, commandPool, pAllocator);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount,
+                                                     uint32_t firstVertex, uint32_t firstInstance) {
+    API_TRACE(CmdDraw);
+    get_cmd_stats(commandBuffer)->draws++;
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+    my_data->device_dispatch_table->CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount,
+                                                            uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+    API_TRACE(CmdDrawIndexed);
+    get_cmd_stats(commandBuffer)->draws++;
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+    my_data->device_dispatch_table->CmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+                                                             uint32_t drawCount, uint32_t stride) {
+    API_TRACE(CmdDrawIndirect);
+    get_cmd_stats(commandBuffer)->draws += drawCount;
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+    my_data->device_dispatch_table->CmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexedIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+                                                                    uint32_t drawCount, uint32_t stride) {
+    API_TRACE(CmdDrawIndexedIndirect);
+    get_cmd_stats(commandBuffer)->draws += drawCount;
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+    my_data->device_dispatch_table->CmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+                                                             VkPipeline pipeline) {
+    API_TRACE(CmdBindPipeline);
+    get_cmd_stats(commandBuffer)->pipelineBinds++;
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+    my_data->device_dispatch_table->CmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+                                                                   VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount,
+                                                                   const VkDescriptorSet *pDescriptorSets, uint32_t dynamicOffsetCount,
+                                                                   const uint32_t *pDynamicOffsets) {
+    API_TRACE(CmdBindDescriptorSets);
+    get_cmd_stats(commandBuffer)->descriptorBinds++;
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+    my_data->device_dispatch_table->CmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount,
+                                                          pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout,
+                                                              VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size,
+                                                              const void *pValues) {
+    API_TRACE(CmdPushConstants);
+    get_cmd_stats(commandBuffer)->pushConstants++;
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+    my_data->device_dispatch_table->CmdPushConstants(commandBuffer, layout, stageFlags, offset, size, pValues);
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkCmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+                                                                const VkCommandBuffer *pCommandBuffers) {
+    API_TRACE(CmdExecuteCommands);
+    layer_data *my_data = get_layer_data(get_dispatch_key(commandBuffer));
+
+    /* the secondaries may still be re-recorded until submit, so resolve their counts then */
+    auto &secondaries = get_cmd_stats(commandBuffer)->secondaries;
+    secondaries.insert(secondaries.end(), pCommandBuffers, pCommandBuffers + commandBufferCount);
+
+    my_data->device_dispatch_table->CmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
+}
+
+/* adds what a submitted command buffer recorded to rec, called with cmdStatsLock held */
+static void add_cmd_stats(layer_data *my_data, VkCommandBuffer commandBuffer, SubmitRecord &rec) {
+    auto it = my_data->cmdBufferStats.find(commandBuffer);
+    if (it == my_data->cmdBufferStats.end()) return;
+
+    const CommandBufferStats &stats = it->second;
+    rec.draws += stats.draws;
+    rec.pipelineBinds += stats.pipelineBinds;
+    rec.descriptorBinds += stats.descriptorBinds;
+    rec.pushConstants += stats.pushConstants;
+
+    for (auto secondary : stats.secondaries) add_cmd_stats(my_data, secondary, rec);
+}
+
+/* returns false if the frame slot is still in use on the GPU */
+static bool collect_gpu_time(layer_data *my_data, uint32_t slot) {
+    if (!my_data->timestampPending[slot]) return true;
+
+    uint64_t ts[2];
+    VkResult res = my_data->device_dispatch_table->GetQueryPoolResults(my_data->dev, my_data->timestampPool, slot * 2, 2, sizeof(ts),
+                                                                        ts, sizeof(ts[0]), VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS) return false;
+
+    uint64_t ticks = (ts[1] - ts[0]) & my_data->timestampMask;
+    my_data->gpuFrameTimes.Add((float)(ticks * my_data->timestampPeriod / 1e6));
+    my_data->timestampPending[slot] = false;
+
+    return true;
+}
+
+VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits,
+                                                             VkFence fence) {
+    API_TRACE(QueueSubmit);
+    layer_data *my_data = get_layer_data(get_dispatch_key(queue));
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
 
-    if (!my_data->fontUploadComplete) {
-        VkSubmitInfo si = {};
-        si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        si.pNext = nullptr;
-        si.waitSemaphoreCount = 0;
-        si.commandBufferCount = 1;
-        si.signalSemaphoreCount = 0;
-        si.pCommandBuffers = &my_data->fontUploadCmdBuffer;
-
-        pTable->QueueSubmit(queue, 1, &si, VK_NULL_HANDLE);
-        my_data->fontUploadComplete = true;
-#ifdef OVERLAY_DEBUG
-        printf("Font image layout transition queued\n");
-#endif
+    QueueMap *queues = my_data->queues.load(std::memory_order_acquire);
+    auto q = queues->find(queue);
+    QueueData *qd = q != queues->end() ? q->second : nullptr;
+
+    /* prepend the begin timestamp to the first submit of the frame on the graphics queue family. only frame timing
+     * needs the device lock, which is taken before and never under the queue's lock */
+    bool frameTimestamp = false;
+    uint32_t frameSlot = 0;
+    if (my_data->timestampPool != VK_NULL_HANDLE && submitCount && qd && qd->family == my_data->graphicsQueueFamilyIndex) {
+        loader_platform_thread_lock_mutex(&my_data->lock);
+        frameSlot = my_data->frame % TIMESTAMP_FRAMES;
+        if (!my_data->timestampBegun) {
+            frameTimestamp = collect_gpu_time(my_data, frameSlot);
+            my_data->timestampBegun = frameTimestamp;
+        }
+
+        /* the slot's previous use has retired, so its begin half can be recorded again. this nests presentLock in the
+         * device lock, which presents never do the other way around */
+        VkPipelineStageFlagBits stage = frame_begin_stage(pSubmits[0]);
+        if (frameTimestamp && stage != my_data->timestampStages[frameSlot]) {
+            std::lock_guard<std::mutex> presentLock(my_data->presentLock);
+            record_frame_begin(my_data, frameSlot, stage);
+        }
+        loader_platform_thread_unlock_mutex(&my_data->lock);
     }
 
-    WsiImageData *id = swapChain->presentableImages[imageIndex];
+    /* wrap every batch in timestamps, unless the slots are all still in flight. the queue's lock is held over the
+     * submit so that a present on another queue cannot read the slots before their resets are queued */
+    std::unique_lock<std::mutex> queueLock;
+    bool timeBatches = false;
+    if (qd && qd->timestampPool != VK_NULL_HANDLE) {
+        queueLock = std::unique_lock<std::mutex>(qd->lock);
+        collect_submit_times(my_data, qd);
+        timeBatches = qd->pending + submitCount <= SUBMIT_TIMESTAMP_SLOTS;
+    }
 
-    /* update the overlay content */
+    SubmitRecord rec;
+    rec.frame = my_data->frame;
+    rec.cpuTimeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - my_data->startTime).count();
 
-    vertex *vertices = nullptr;
+    for (uint32_t i = 0; i < submitCount; i++) {
+        rec.commandBuffers = pSubmits[i].commandBufferCount;
+        rec.waitSemaphores = pSubmits[i].waitSemaphoreCount;
+        rec.signalSemaphores = pSubmits[i].signalSemaphoreCount;
+        rec.draws = rec.pipelineBinds = rec.descriptorBinds = rec.pushConstants = 0;
 
-    /* guaranteed not in flight due to WSI surface being available */
-    VkResult U_ASSERT_ONLY err =
-        pTable->MapMemory(my_data->dev, id->vertexBufferMemory, 0, id->vertexBufferSize, 0, (void **)&vertices);
-    assert(!err);
+        my_data->cmdStatsLock.lock();
+        for (uint32_t j = 0; j < pSubmits[i].commandBufferCount; j++) add_cmd_stats(my_data, pSubmits[i].pCommandBuffers[j], rec);
+        my_data->cmdStatsLock.unlock();
+
+        my_data->cmdBuffersThisFrame += rec.commandBuffers;
+        my_data->drawsThisFrame += rec.draws;
+        my_data->pipelineBindsThisFrame += rec.pipelineBinds;
+        my_data->descriptorBindsThisFrame += rec.descriptorBinds;
+        my_data->pushConstantsThisFrame += rec.pushConstants;
 
-    /* write vertices for string in here */
-    id->numVertices = fill_vertex_buffer(my_data, vertices, imageIndex);
+        if (!qd) continue;
 
-    pTable->UnmapMemory(my_data->dev, id->vertexBufferMemory);
+        qd->batches++;
+        qd->commandBuffers += rec.commandBuffers;
+        qd->waitSemaphores += rec.waitSemaphores;
+        qd->signalSemaphores += rec.signalSemaphores;
+
+        if (timeBatches) {
+            qd->records[(qd->oldest + qd->pending + i) % SUBMIT_TIMESTAMP_SLOTS] = rec;
+        } else {
+            queue_submit_record(my_data, qd, rec, -1.0, -1.0);
+        }
+    }
+
+    uint32_t firstSlot = 0;
+    if (timeBatches) {
+        firstSlot = qd->oldest + qd->pending;
+        qd->pending += submitCount;
+    }
+
+    if (!frameTimestamp && !timeBatches) return pTable->QueueSubmit(queue, submitCount, pSubmits, fence);
+
+    uint32_t cmdCount = 1;
+    for (uint32_t i = 0; i < submitCount; i++) cmdCount += pSubmits[i].commandBufferCount + 2;
+
+    /* reserved up front so the per-batch pointers stay valid */
+    std::vector<VkCommandBuffer> cmds;
+    cmds.reserve(cmdCount);
+    std::vector<VkSubmitInfo> submits(pSubmits, pSubmits + submitCount);
+
+    for (uint32_t i = 0; i < submitCount; i++) {
+        size_t first = cmds.size();
+        uint32_t slot = (firstSlot + i) % SUBMIT_TIMESTAMP_SLOTS;
+
+        if (timeBatches) cmds.push_back(qd->beginCmds[slot]);
+        if (frameTimestamp && i == 0) cmds.push_back(my_data->timestampCmds[frameSlot]);
+        cmds.insert(cmds.end(), pSubmits[i].pCommandBuffers, pSubmits[i].pCommandBuffers + pSubmits[i].commandBufferCount);
+        if (timeBatches) cmds.push_back(qd->endCmds[slot]);
+
+        submits[i].commandBufferCount = (uint32_t)(cmds.size() - first);
+        submits[i].pCommandBuffers = cmds.data() + first;
+    }
+
+    return pTable->QueueSubmit(queue, submitCount, submits.data(), fence);
+}
+
+/* a recycled slot was waited on before reuse */
+static bool overlay_submit_retired(layer_data *my_data, uint64_t serial) {
+    const OverlaySubmit &os = my_data->overlaySubmits[serial % OVERLAY_SUBMITS];
+    return !serial || os.serial != serial ||
+           my_data->device_dispatch_table->GetFenceStatus(my_data->dev, os.fence) == VK_SUCCESS;
+}
+
+/* frees the overlay resources of destroyed swapchains once no overlay submit uses them, or all of them on an idle
+ * device. called with presentLock held, which also guards the command pool. */
+static void release_retired_swapchains(layer_data *my_data, bool idle) {
+    auto &retired = my_data->retiredSwapChains;
+    for (size_t i = 0; i < retired.size();) {
+        if (!idle && !overlay_submit_retired(my_data, retired[i]->retireSerial)) {
+            i++;
+            continue;
+        }
+
+        retired[i]->Cleanup(my_data->dev);
+        delete retired[i];
+        retired[i] = retired.back();
+        retired.pop_back();
+    }
+}
+
+/* records the overlay draw for one swapchain image, returning its command buffer. called with presentLock held */
+static VkCommandBuffer record_overlay(layer_data *my_data, SwapChainData *swapChain, unsigned imageIndex, const HudText &hud,
+                                      const FrameStats &cpuFrameTimes, int timestampSlot) {
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkResult U_ASSERT_ONLY err;
+
+    WsiImageData *id = swapChain->presentableImages[imageIndex];
+
+    /* the image was acquired again, so its previous overlay submit has long retired and this does not block.
+     * if the submit slot has been reused since, it was waited on then. */
+    if (id->submitSerial) {
+        const OverlaySubmit &prev = my_data->overlaySubmits[id->submitSerial % OVERLAY_SUBMITS];
+        if (prev.serial == id->submitSerial) {
+            err = pTable->WaitForFences(my_data->dev, 1, &prev.fence, VK_TRUE, UINT64_MAX);
+            assert(!err);
+        }
+    }
+    id->submitSerial = my_data->presentSerial;
+
+    /* update the overlay content */
+    fill_glyph_buffer(my_data, id, hud, cpuFrameTimes);
 
     /* JIT record a command buffer to draw the overlay */
 
@@ -994,7 +2740,7 @@ static void before_present(VkQueue queue, layer_data *my_data, SwapChainData *sw
     VkImageMemoryBarrier imb;
     imb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     imb.pNext = nullptr;
-    imb.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    imb.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     imb.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     imb.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     imb.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -1020,7 +2766,8 @@ static void before_present(VkQueue queue, layer_data *my_data, SwapChainData *sw
     rpbi.pClearValues = nullptr;
 
     pTable->BeginCommandBuffer(id->cmd, &cbbi);
-    pTable->CmdPipelineBarrier(id->cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+    /* chained to the semaphore wait stage */
+    pTable->CmdPipelineBarrier(id->cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                                0 /* dependency flags */, 0, nullptr, /* memory barriers */
                                0, nullptr,                           /* buffer memory barriers */
                                1, &imb);                             /* image memory barriers */
@@ -1034,61 +2781,162 @@ static void before_present(VkQueue queue, layer_data *my_data, SwapChainData *sw
 
     pTable->CmdBindVertexBuffers(id->cmd, 0, 1, buffers, offsets);
 
-    pTable->CmdDraw(id->cmd, id->numVertices, 1, 0, 0);
+    pTable->CmdDraw(id->cmd, 4, id->numGlyphs, 0, 0);
 
     pTable->CmdEndRenderPass(id->cmd);
+
+    if (timestampSlot >= 0) {
+        pTable->CmdWriteTimestamp(id->cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, my_data->timestampPool, timestampSlot * 2 + 1);
+    }
+
     pTable->EndCommandBuffer(id->cmd);
 
-    /* Schedule this command buffer for execution. TODO: Do we need to protect
-     * ourselves from an app that didn't wait for the presentation image to
-     * be idle before mangling it? If the app is well-behaved, our command
-     * buffer is guaranteed to have been retired before the app tries to
-     * present it again.
-     */
-    VkSubmitInfo si = {};
-    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    si.pNext = nullptr;
-    si.waitSemaphoreCount = 0;
-    si.commandBufferCount = 1;
-    si.signalSemaphoreCount = 0;
-    si.pCommandBuffers = &id->cmd;
-    pTable->WaitForFences(my_data->dev, 1, &my_data->fence, VK_TRUE, UINT64_MAX);
-    pTable->ResetFences(my_data->dev, 1, &my_data->fence);
-    pTable->QueueSubmit(queue, 1, &si, my_data->fence);
+    return id->cmd;
+}
 
-    /* Reset per-frame stats */
-    my_data->cmdBuffersThisFrame = 0;
+static void end_frame(layer_data *my_data) {
+    auto now = std::chrono::steady_clock::now();
+    if (my_data->frame) my_data->cpuFrameTimes.Add(std::chrono::duration<float, std::milli>(now - my_data->lastPresent).count());
+    my_data->lastPresent = now;
+
+    /* pick up whatever earlier frames and batches have finished */
+    if (my_data->timestampPool != VK_NULL_HANDLE) {
+        for (uint32_t i = 0; i < TIMESTAMP_FRAMES; i++) collect_gpu_time(my_data, i);
+    }
+    for (auto &q : *my_data->queues.load(std::memory_order_acquire)) {
+        QueueData *qd = q.second;
+        if (qd->timestampPool == VK_NULL_HANDLE) continue;
+
+        std::lock_guard<std::mutex> queueLock(qd->lock);
+        collect_submit_times(my_data, qd);
+    }
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(queue), layer_data_map);
+    API_TRACE(QueuePresentKHR);
+    layer_data *my_data = get_layer_data(get_dispatch_key(queue));
+
+    VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
+    VkResult U_ASSERT_ONLY err;
+
+    /* the device lock is only held to take a snapshot of the stats and start the next frame's */
+    loader_platform_thread_lock_mutex(&my_data->lock);
+
+    end_frame(my_data);
+
+    /* the frame counter moves with the first swapchain, so the end timestamp goes there */
+    int timestampSlot = my_data->timestampBegun ? (int)(my_data->frame % TIMESTAMP_FRAMES) : -1;
+    if (timestampSlot >= 0) my_data->timestampPending[timestampSlot] = true;
 
+    std::vector<SwapChainData *> swapChains(pPresentInfo->swapchainCount);
+    std::vector<HudText> huds(pPresentInfo->swapchainCount);
     for (uint32_t i = 0; i < pPresentInfo->swapchainCount; i++) {
         auto data = my_data->swapChains->find(pPresentInfo->pSwapchains[i]);
         assert(data != my_data->swapChains->end());
+        swapChains[i] = data->second;
 
-        before_present(queue, my_data, data->second, pPresentInfo->pImageIndices[i]);
+        format_hud(my_data, pPresentInfo->pImageIndices[i], huds[i]);
     }
+    FrameStats cpuFrameTimes = my_data->cpuFrameTimes;
 
-    VkResult result = my_data->pfnQueuePresentKHR(queue, pPresentInfo);
+    /* Reset per-frame stats */
+    my_data->cmdBuffersThisFrame = 0;
+    my_data->drawsThisFrame = 0;
+    my_data->pipelineBindsThisFrame = 0;
+    my_data->descriptorBindsThisFrame = 0;
+    my_data->pushConstantsThisFrame = 0;
+    my_data->timestampBegun = false;
+    for (auto &q : *my_data->queues.load(std::memory_order_acquire)) {
+        QueueData *qd = q.second;
+        qd->batches = qd->commandBuffers = qd->waitSemaphores = qd->signalSemaphores = 0;
+    }
+
+    loader_platform_thread_unlock_mutex(&my_data->lock);
+
+    /* the waits, recording and submit below only contend with other presents */
+    std::unique_lock<std::mutex> presentLock(my_data->presentLock);
+
+    /* the upload was usually queued at device creation and has long finished, the wait orders it before our draws */
+    if (!my_data->fontUploadSubmitted) submit_font_upload(my_data, queue);
+    if (my_data->fontStagingBuffer != VK_NULL_HANDLE) {
+        err = pTable->WaitForFences(my_data->dev, 1, &my_data->fontUploadFence, VK_TRUE, UINT64_MAX);
+        assert(!err);
+
+        pTable->DestroyBuffer(my_data->dev, my_data->fontStagingBuffer, nullptr);
+        pTable->FreeMemory(my_data->dev, my_data->fontStagingMemory, nullptr);
+        my_data->fontStagingBuffer = VK_NULL_HANDLE;
+    }
+
+    /* recycle the oldest submit slot, which retired frames ago */
+    uint64_t serial = ++my_data->presentSerial;
+    OverlaySubmit &os = my_data->overlaySubmits[serial % OVERLAY_SUBMITS];
+    if (os.serial) {
+        err = pTable->WaitForFences(my_data->dev, 1, &os.fence, VK_TRUE, UINT64_MAX);
+        assert(!err);
+        pTable->ResetFences(my_data->dev, 1, &os.fence);
+    }
+    os.serial = serial;
+
+    if (!my_data->retiredSwapChains.empty()) release_retired_swapchains(my_data, false);
+
+    std::vector<VkCommandBuffer> cmds;
+    cmds.reserve(pPresentInfo->swapchainCount);
+
+    for (uint32_t i = 0; i < pPresentInfo->swapchainCount; i++) {
+        cmds.push_back(record_overlay(my_data, swapChains[i], pPresentInfo->pImageIndices[i], huds[i], cpuFrameTimes,
+                                      i == 0 ? timestampSlot : -1));
+    }
+
+    /* a single submit draws every swapchain's overlay after the app's rendering, and the present waits on it in turn */
+    std::vector<VkPipelineStageFlags> waitStages(pPresentInfo->waitSemaphoreCount, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    VkSubmitInfo si = {};
+    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.pNext = nullptr;
+    si.waitSemaphoreCount = pPresentInfo->waitSemaphoreCount;
+    si.pWaitSemaphores = pPresentInfo->pWaitSemaphores;
+    si.pWaitDstStageMask = waitStages.data();
+    si.commandBufferCount = (uint32_t)cmds.size();
+    si.pCommandBuffers = cmds.data();
+    si.signalSemaphoreCount = 1;
+    si.pSignalSemaphores = &os.semaphore;
+    pTable->QueueSubmit(queue, 1, &si, os.fence);
+    VkSemaphore overlayDone = os.semaphore;
+
+    presentLock.unlock();
+
+    /* take over the queued trace records, taking traceLock first so that a later present cannot write ahead of us */
+    if (my_data->traceFile) {
+        std::lock_guard<std::mutex> traceLock(my_data->traceLock);
+        my_data->traceQueuedLock.lock();
+        my_data->traceWriting.swap(my_data->traceQueued);
+        my_data->traceQueuedLock.unlock();
+
+        write_submit_records(my_data);
+    }
+
+    VkPresentInfoKHR pi = *pPresentInfo;
+    pi.waitSemaphoreCount = 1;
+    pi.pWaitSemaphores = &overlayDone;
+
+    VkResult result = my_data->pfnQueuePresentKHR(queue, &pi);
     return result;
 }
 
 void WsiImageData::Cleanup(VkDevice dev) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(dev), layer_data_map);
+    layer_data *my_data = get_layer_data(get_dispatch_key(dev));
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
-    pTable->DeviceWaitIdle(dev);
 
-    // XXX: needs device data
-    //    pTable->FreeCommandBuffers(dev, cmd, nullptr);
+    pTable->FreeCommandBuffers(dev, my_data->pool, 1, &cmd);
     pTable->DestroyFramebuffer(dev, framebuffer, nullptr);
     pTable->DestroyImageView(dev, view, nullptr);
     pTable->DestroyBuffer(dev, vertexBuffer, nullptr);
+    pTable->UnmapMemory(dev, vertexBufferMemory);
     pTable->FreeMemory(dev, vertexBufferMemory, nullptr);
 }
 
 void SwapChainData::Cleanup(VkDevice dev) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(dev), layer_data_map);
+    layer_data *my_data = get_layer_data(get_dispatch_key(dev));
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
 
     for (uint32_t i = 0; i < presentableImages.size(); i++) {
@@ -1105,6 +2953,36 @@ void SwapChainData::Cleanup(VkDevice dev) {
 void layer_data::Cleanup() {
     VkLayerDispatchTable *pTable = this->device_dispatch_table;
 
+    release_retired_swapchains(this, true);
+
+    /* the device is idle, so every timed batch can be retired */
+    QueueMap *queueMap = queues.load(std::memory_order_relaxed);
+    for (auto &q : *queueMap) {
+        QueueData *qd = q.second;
+        if (qd->timestampPool != VK_NULL_HANDLE) {
+            collect_submit_times(this, qd);
+            pTable->FreeCommandBuffers(dev, qd->pool, SUBMIT_TIMESTAMP_SLOTS, qd->beginCmds);
+            pTable->FreeCommandBuffers(dev, qd->pool, SUBMIT_TIMESTAMP_SLOTS, qd->endCmds);
+            pTable->DestroyCommandPool(dev, qd->pool, nullptr);
+            pTable->DestroyQueryPool(dev, qd->timestampPool, nullptr);
+        }
+        delete qd;
+    }
+    delete queueMap;
+    for (auto map : retiredQueueMaps) delete map;
+    retiredQueueMaps.clear();
+
+    if (traceFile) {
+        std::lock_guard<std::mutex> lock(traceLock);
+        traceWriting.insert(traceWriting.end(), traceQueued.begin(), traceQueued.end());
+        traceQueued.clear();
+        write_submit_records(this);
+
+        if (traceJson) fputs("\n]\n", traceFile);
+        fclose(traceFile);
+        traceFile = nullptr;
+    }
+
     pTable->DestroySampler(dev, sampler, nullptr);
     pTable->DestroyDescriptorPool(dev, desc_pool, nullptr);
     pTable->DestroyPipelineLayout(dev, pl, nullptr);
@@ -1114,24 +2992,43 @@ void layer_data::Cleanup() {
     pTable->FreeMemory(dev, fontGlyphsMemory, nullptr);
 
     pTable->FreeCommandBuffers(dev, pool, 1, &fontUploadCmdBuffer);
+    pTable->DestroyFence(dev, fontUploadFence, nullptr);
+    for (auto &os : overlaySubmits) {
+        pTable->DestroyFence(dev, os.fence, nullptr);
+        pTable->DestroySemaphore(dev, os.semaphore, nullptr);
+    }
+    if (fontStagingBuffer != VK_NULL_HANDLE) {
+        pTable->DestroyBuffer(dev, fontStagingBuffer, nullptr);
+        pTable->FreeMemory(dev, fontStagingMemory, nullptr);
+    }
+    if (timestampPool != VK_NULL_HANDLE) {
+        pTable->FreeCommandBuffers(dev, pool, TIMESTAMP_FRAMES, timestampCmds);
+        pTable->DestroyQueryPool(dev, timestampPool, nullptr);
+    }
     pTable->DestroyCommandPool(dev, pool, nullptr);
 
     pTable->DestroyShaderModule(dev, vsShaderModule, nullptr);
     pTable->DestroyShaderModule(dev, fsShaderModule, nullptr);
-    pTable->DestroyFence(dev, fence, nullptr);
 }
 
 VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain,
                                                                  const VkAllocationCallbacks *pAllocator) {
-    layer_data *my_data = GetLayerDataPtr(get_dispatch_key(device), layer_data_map);
+    API_TRACE(DestroySwapchainKHR);
+    layer_data *my_data = get_layer_data(get_dispatch_key(device));
 
-    /* Clean up our resources associated with this swapchain */
+    /* our resources associated with this swapchain may still be used by the last overlay submits, so rather than
+     * waiting for the device to idle they are freed by a later present or destroy once those have retired */
+    loader_platform_thread_lock_mutex(&my_data->lock);
     auto it = my_data->swapChains->find(swapchain);
     assert(it != my_data->swapChains->end());
+    SwapChainData *data = it->second;
+    my_data->swapChains->erase(it);
+    loader_platform_thread_unlock_mutex(&my_data->lock);
 
-    it->second->Cleanup(device);
-    delete it->second;
-    my_data->swapChains->erase(it->first);
+    std::lock_guard<std::mutex> presentLock(my_data->presentLock);
+    data->retireSerial = my_data->presentSerial;
+    my_data->retiredSwapChains.push_back(data);
+    release_retired_swapchains(my_data, false);
 
     my_data->pfnDestroySwapchainKHR(device, swapchain, pAllocator);
 }
@@ -1147,12 +3044,31 @@ VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkD
     ADD_HOOK(vkQueuePresentKHR);
     ADD_HOOK(vkDestroySwapchainKHR);
     ADD_HOOK(vkQueueSubmit);
+    ADD_HOOK(vkGetDeviceQueue);
+    ADD_HOOK(vkBeginCommandBuffer);
+    ADD_HOOK(vkAllocateCommandBuffers);
+    ADD_HOOK(vkFreeCommandBuffers);
+    ADD_HOOK(vkDestroyCommandPool);
+    ADD_HOOK(vkCmdDraw);
+    ADD_HOOK(vkCmdDrawIndexed);
+    ADD_HOOK(vkCmdDrawIndirect);
+    ADD_HOOK(vkCmdDrawIndexedIndirect);
+    ADD_HOOK(vkCmdBindPipeline);
+    ADD_HOOK(vkCmdBindDescriptorSets);
+    ADD_HOOK(vkCmdPushConstants);
+    ADD_HOOK(vkCmdExecuteCommands);
+    ADD_HOOK(vkAllocateMemory);
+    ADD_HOOK(vkFreeMemory);
+    ADD_HOOK(vkBindBufferMemory);
+    ADD_HOOK(vkBindImageMemory);
+    ADD_HOOK(vkDestroyBuffer);
+    ADD_HOOK(vkDestroyImage);
 #undef ADD_HOOK
 
     if (dev == NULL) return NULL;
 
     layer_data *dev_data;
-    dev_data = GetLayerDataPtr(get_dispatch_key(dev), layer_data_map);
+    dev_data = get_layer_data(get_dispatch_key(dev));
     VkLayerDispatchTable *pTable = dev_data->device_dispatch_table;
 
     if (pTable->GetDeviceProcAddr == NULL) return NULL;
@@ -1171,7 +3087,7 @@ VK_LAYER_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(V
     if (instance == NULL) return NULL;
 
     layer_data *instance_data;
-    instance_data = GetLayerDataPtr(get_dispatch_key(instance), layer_data_map);
+    instance_data = get_layer_data(get_dispatch_key(instance));
     VkLayerInstanceDispatchTable *pTable = instance_data->instance_dispatch_table;
 
     if (pTable->GetInstanceProcAddr == NULL) return NULL;
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2016 Google, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Convert an overlay API trace (VK_OVERLAY_API_TRACE) to Chrome trace JSON.
+
+The input is little endian: a header of magic, version and call count
+(uint32 each), the call names as uint8 length prefixed strings, then
+16-byte records of start (uint64 ns), duration (uint32 ns), call (uint16)
+and thread (uint16).  Load the output in chrome://tracing or Perfetto.
+"""
+
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0x54415056
+TRACE_VERSION = 1
+RECORD = struct.Struct('<QIHH')
+
+
+def read_trace(data):
+    magic, version, call_count = struct.unpack_from('<III', data, 0)
+    if magic != TRACE_MAGIC:
+        raise ValueError('not an overlay API trace')
+    if version != TRACE_VERSION:
+        raise ValueError('unsupported trace version %d' % version)
+
+    offset = 12
+    names = []
+    for _ in range(call_count):
+        length = data[offset]
+        names.append(data[offset + 1:offset + 1 + length].decode('ascii'))
+        offset += 1 + length
+
+    # a trace cut short by a crash can end mid-record
+    end = offset + (len(data) - offset) // RECORD.size * RECORD.size
+    for start, duration, call, thread in RECORD.iter_unpack(data[offset:end]):
+        yield names[call] if call < len(names) else 'call%d' % call, start, duration, thread
+
+
+def main(argv):
+    if len(argv) != 3:
+        print('usage: %s <trace.bin> <trace.json>' % argv[0])
+        return 1
+
+    with open(argv[1], 'rb') as f:
+        data = f.read()
+
+    events = []
+    for name, start, duration, thread in read_trace(data):
+        events.append({
+            'name': name,
+            'ph': 'X',
+            'pid': 0,
+            'tid': thread,
+            'ts': start / 1000.0,
+            'dur': duration / 1000.0,
+        })
+    events.sort(key=lambda e: e['ts'])
+
+    with open(argv[2], 'w') as f:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, f)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -5,13 +5,16 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-layout(location=0) in vec4 pos;
-layout(location=1) in vec2 uv_in;
+/* per glyph instance: x0, y0, x1, y1 and s0, t0, s1, t1 */
+layout(location=0) in vec4 rect;
+layout(location=1) in vec4 uv_rect;
 
 layout(location=0) out vec2 uv;
 
 void main() {
-    gl_Position.xy = (pos.xy / 256.0) - 1.0;
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+
+    gl_Position.xy = (mix(rect.xy, rect.zw, corner) / 256.0) - 1.0;
     gl_Position.zw = vec2(0, 1);
-    uv = uv_in;
+    uv = mix(uv_rect.xy, uv_rect.zw, corner);
 }
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "DeletionQueue.h"
+#include "Helpers.h"
+
+DeletionQueue::DeletionQueue(VkDevice dev) : dev_(dev), submitted_serial_(0), completed_serial_(0), stats_() {}
+
+DeletionQueue::~DeletionQueue() { assert(entries_.empty()); }
+
+void DeletionQueue::push(Type type, uint64_t handle, VkDeviceSize size) {
+    if (!handle) return;
+
+    entries_.push_back(Entry{type, handle, size, submitted_serial_});
+
+    stats_.retained_handles++;
+    stats_.retained_bytes += size;
+    stats_.peak_retained_bytes = std::max(stats_.peak_retained_bytes, stats_.retained_bytes);
+}
+
+void DeletionQueue::submit(VkFence fence) { submissions_.push_back(Submission{++submitted_serial_, fence}); }
+
+void DeletionQueue::collect() {
+    // a fence may have been reset and reused since, but then it was for a later submission; and submissions complete
+    // in order, so the latest signaled one covers all before it
+    for (const auto &sub : submissions_) {
+        if (vk::GetFenceStatus(dev_, sub.fence) == VK_SUCCESS) completed_serial_ = std::max(completed_serial_, sub.serial);
+    }
+
+    while (!submissions_.empty() && submissions_.front().serial <= completed_serial_) submissions_.pop_front();
+
+    while (!entries_.empty() && entries_.front().serial <= completed_serial_) {
+        destroy(entries_.front());
+        entries_.pop_front();
+    }
+}
+
+void DeletionQueue::flush() {
+    for (const auto &entry : entries_) destroy(entry);
+    entries_.clear();
+
+    submissions_.clear();
+    completed_serial_ = submitted_serial_;
+}
+
+void DeletionQueue::destroy(const Entry &entry) {
+    switch (entry.type) {
+        case TYPE_BUFFER:
+            vk::DestroyBuffer(dev_, (VkBuffer)entry.handle, nullptr);
+            break;
+        case TYPE_IMAGE:
+            vk::DestroyImage(dev_, (VkImage)entry.handle, nullptr);
+            break;
+        case TYPE_IMAGE_VIEW:
+            vk::DestroyImageView(dev_, (VkImageView)entry.handle, nullptr);
+            break;
+        case TYPE_FRAMEBUFFER:
+            vk::DestroyFramebuffer(dev_, (VkFramebuffer)entry.handle, nullptr);
+            break;
+        case TYPE_DEVICE_MEMORY:
+            vk::FreeMemory(dev_, (VkDeviceMemory)entry.handle, nullptr);
+            break;
+        case TYPE_DESCRIPTOR_POOL:
+            vk::DestroyDescriptorPool(dev_, (VkDescriptorPool)entry.handle, nullptr);
+            break;
+        case TYPE_DESCRIPTOR_SET_LAYOUT:
+            vk::DestroyDescriptorSetLayout(dev_, (VkDescriptorSetLayout)entry.handle, nullptr);
+            break;
+        case TYPE_PIPELINE:
+            vk::DestroyPipeline(dev_, (VkPipeline)entry.handle, nullptr);
+            break;
+        case TYPE_PIPELINE_LAYOUT:
+            vk::DestroyPipelineLayout(dev_, (VkPipelineLayout)entry.handle, nullptr);
+            break;
+        case TYPE_SHADER_MODULE:
+            vk::DestroyShaderModule(dev_, (VkShaderModule)entry.handle, nullptr);
+            break;
+        case TYPE_RENDER_PASS:
+            vk::DestroyRenderPass(dev_, (VkRenderPass)entry.handle, nullptr);
+            break;
+        case TYPE_COMMAND_POOL:
+            vk::DestroyCommandPool(dev_, (VkCommandPool)entry.handle, nullptr);
+            break;
+        case TYPE_QUERY_POOL:
+            vk::DestroyQueryPool(dev_, (VkQueryPool)entry.handle, nullptr);
+            break;
+        case TYPE_FENCE:
+            vk::DestroyFence(dev_, (VkFence)entry.handle, nullptr);
+            break;
+        case TYPE_SEMAPHORE:
+            vk::DestroySemaphore(dev_, (VkSemaphore)entry.handle, nullptr);
+            break;
+    }
+
+    stats_.retained_handles--;
+    stats_.retained_bytes -= entry.size;
+    stats_.destroyed_handles++;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2016 Google, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+#include <deque>
+#include <vulkan/vulkan.h>
+
+// Holds on to handles that submissions in flight may still use.  A handle is
+// destroyed once the fence of the last submission made before it was pushed
+// has signaled.  The submissions are assumed to complete in order, as they do
+// on a single queue.  It is not thread-safe and is meant to be used from the
+// thread that presents.
+class DeletionQueue {
+   public:
+    explicit DeletionQueue(VkDevice dev);
+    ~DeletionQueue();
+
+    enum Type {
+        TYPE_BUFFER,
+        TYPE_IMAGE,
+        TYPE_IMAGE_VIEW,
+        TYPE_FRAMEBUFFER,
+        TYPE_DEVICE_MEMORY,
+        TYPE_DESCRIPTOR_POOL,
+        TYPE_DESCRIPTOR_SET_LAYOUT,
+        TYPE_PIPELINE,
+        TYPE_PIPELINE_LAYOUT,
+        TYPE_SHADER_MODULE,
+        TYPE_RENDER_PASS,
+        TYPE_COMMAND_POOL,
+        TYPE_QUERY_POOL,
+        TYPE_FENCE,
+        TYPE_SEMAPHORE,
+    };
+
+    // the type is explicit as non-dispatchable handles are all uint64_t on 32-bit platforms
+    void push(Type type, uint64_t handle, VkDeviceSize size = 0);
+
+    // called right after each submission signaling fence, usually a frame fence
+    void submit(VkFence fence);
+    // destroys the handles whose submissions are done; called after waiting for a fence and before resetting it
+    void collect();
+    // the device must be idle
+    void flush();
+
+    struct Stats {
+        uint64_t retained_handles;
+        VkDeviceSize retained_bytes;
+        VkDeviceSize peak_retained_bytes;
+        uint64_t destroyed_handles;
+    };
+    const Stats &stats() const { return stats_; }
+
+   private:
+    struct Entry {
+        Type type;
+        uint64_t handle;
+        // only known for device memory
+        VkDeviceSize size;
+        // the last submission that may use it
+        uint64_t serial;
+    };
+
+    struct Submission {
+        uint64_t serial;
+        VkFence fence;
+    };
+
+    void destroy(const Entry &entry);
+
+    VkDevice dev_;
+    uint64_t submitted_serial_;
+    uint64_t completed_serial_;
+
+    // in push order, and so in serial order
+    std::deque<Entry> entries_;
+    // not known to be done yet, in serial order
+    std::deque<Submission> submissions_;
+    Stats stats_;
+};
+
+#endif  // DELETIONQUEUE_H
@@ -17,6 +17,7 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -34,9 +35,13 @@ class Game {
         int initial_height;
         int queue_count;
         int back_buffer_count;
+        int frames_in_flight;
         int ticks_per_second;
         bool vsync;
         bool animate;
+        bool low_latency;
+        // set by games that blit into the swapchain images
+        bool swapchain_transfer_dst;
 
         bool validate;
         bool validate_verbose;
@@ -52,6 +57,10 @@ class Game {
 
     virtual void attach_swapchain() {}
     virtual void detach_swapchain() {}
+    // called when the swapchain is recreated while frames are still in flight; games that can defer destroying their
+    // swapchain resources (e.g. through the deletion queue) do so and return true, otherwise the shell waits for the
+    // device to idle and calls detach_swapchain
+    virtual bool retire_swapchain() { return false; }
 
     enum Key {
         // virtual keys
@@ -67,6 +76,8 @@ class Game {
     virtual void on_key(Key key) {}
     virtual void on_tick() {}
 
+    // called before input is processed for the next frame
+    virtual void on_frame_begin() {}
     virtual void on_frame(float frame_pred) {}
 
    protected:
@@ -76,9 +87,12 @@ class Game {
         settings_.initial_height = 1024;
         settings_.queue_count = 1;
         settings_.back_buffer_count = 1;
+        settings_.frames_in_flight = 2;
         settings_.ticks_per_second = 30;
         settings_.vsync = true;
         settings_.animate = true;
+        settings_.low_latency = false;
+        settings_.swapchain_transfer_dst = false;
 
         settings_.validate = false;
         settings_.validate_verbose = false;
@@ -104,6 +118,14 @@ class Game {
             } else if (*it == "-h") {
                 ++it;
                 settings_.initial_height = std::stoi(*it);
+            } else if (*it == "-f") {
+                ++it;
+                settings_.frames_in_flight = std::min(std::max(std::stoi(*it), 1), 4);
+            } else if (*it == "-t") {
+                ++it;
+                settings_.ticks_per_second = std::max(std::stoi(*it), 1);
+            } else if (*it == "-ll") {
+                settings_.low_latency = true;
             } else if ((*it == "-v") || (*it == "--validate")) {
                 settings_.validate = true;
             } else if (*it == "-vv") {
@@ -0,0 +1,21 @@
+#version 310 es
+
+precision highp float;
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform highp subpassInput accum;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform highp subpassInput revealage;
+
+layout(location = 0) out vec4 fragcolor;
+
+void main()
+{
+	vec4 sum = subpassLoad(accum);
+	float reveal = subpassLoad(revealage).r;
+
+	// nothing was drawn here
+	if (reveal >= 1.0)
+		discard;
+
+	// the weighted average color, blended over the background by the total coverage
+	fragcolor = vec4(sum.rgb / max(sum.a, 1e-5), 1.0 - reveal);
+}
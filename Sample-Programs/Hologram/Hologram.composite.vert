@@ -0,0 +1,8 @@
+#version 310 es
+
+// a fullscreen triangle
+void main()
+{
+	vec2 pos = vec2(float((gl_VertexIndex << 1) & 2), float(gl_VertexIndex & 2));
+	gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,39 @@
+#version 310 es
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec3 in_normal;
+
+struct Instance {
+	mat4 model;
+	vec4 light_pos;
+	vec4 light_color;
+};
+
+// written by Hologram.comp, indexed by firstInstance
+layout(std430, set = 0, binding = 0) readonly buffer instance_block {
+	Instance instances[];
+};
+
+layout(std140, push_constant) uniform param_block {
+	mat4 view_projection;
+} params;
+
+layout(location = 0) out vec3 color;
+layout(location = 1) out float alpha;
+
+void main()
+{
+	Instance instance = instances[gl_InstanceIndex];
+
+	vec3 world_light = vec3(instance.model * vec4(instance.light_pos.xyz, 1.0));
+	vec3 world_pos = vec3(instance.model * vec4(in_pos, 1.0));
+	vec3 world_normal = mat3(instance.model) * in_normal;
+
+	vec3 light_dir = world_light - world_pos;
+	float brightness = dot(light_dir, world_normal) / length(light_dir) / length(world_normal);
+	brightness = abs(brightness);
+
+	gl_Position = params.view_projection * vec4(world_pos, 1.0);
+	color = instance.light_color.xyz * brightness;
+	alpha = instance.light_pos.w;
+}
@@ -15,11 +15,15 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <array>
+#include <cfloat>
 
+#include <glm/gtc/matrix_access.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "DeletionQueue.h"
 #include "Helpers.h"
 #include "Hologram.h"
 #include "Meshes.h"
@@ -37,28 +41,94 @@ struct ShaderParamBlock {
     float alpha;
 };
 
+// std430 layouts of Hologram.comp
+struct ComputeParamBlock {
+    float tick_interval;
+    uint32_t tick_count;
+    uint32_t object_count;
+    uint32_t fade;
+};
+
+struct ObjectBlock {
+    float angle_scale[4];
+    float axis_speed[4];
+    float light_pos[4];
+    float light_color[4];
+    float alpha[4];
+
+    float origin[4];
+    float subpath[4];
+    float curve_a[4];
+    float curve_b[4];
+    float segment[4];
+
+    uint32_t rng[4];
+};
+
+struct InstanceBlock {
+    float model[4 * 4];
+    float light_pos[4];
+    float light_color[4];
+};
+
+// all meshes fit in [-1, 1]^3 before scaling
+float bounding_radius(const Simulation::Object &obj) { return 1.7321f * obj.animation.data().scale; }
+
 }  // namespace
 
 Hologram::Hologram(const std::vector<std::string> &args)
     : Game("Hologram", args),
       multithread_(true),
       use_push_constants_(false),
+      use_compute_(false),
+      reuse_secondaries_(false),
+      sort_objects_(false),
+      use_oit_(false),
+      cull_objects_(false),
+      dynamic_res_(false),
       sim_paused_(false),
       sim_fade_(false),
       sim_(5000),
+      sim_frame_pred_(1.0f),
       camera_(2.5f),
       frame_data_(),
-      render_pass_clear_value_({{0.0f, 0.1f, 0.2f, 1.0f}}),
+      render_pass_clear_values_(),
       render_pass_begin_info_(),
       primary_cmd_begin_info_(),
-      primary_cmd_submit_info_() {
+      primary_cmd_submit_info_(),
+      gpu_budget_ms_(0.0f),
+      gpu_time_ms_(0.0f),
+      render_scale_(1.0f),
+      render_scale_hold_(0),
+      gpu_timestamps_(false),
+      frame_time_count_(0),
+      gpu_time_sum_ms_(0.0),
+      gpu_time_samples_(0) {
     for (auto it = args.begin(); it != args.end(); ++it) {
         if (*it == "-s")
             multithread_ = false;
         else if (*it == "-p")
             use_push_constants_ = true;
+        else if (*it == "-c")
+            use_compute_ = true;
+        else if (*it == "-r")
+            reuse_secondaries_ = true;
+        else if (*it == "-z")
+            sort_objects_ = true;
+        else if (*it == "-oit")
+            use_oit_ = true;
+        else if (*it == "-cull")
+            cull_objects_ = true;
+        else if (*it == "-drs") {
+            ++it;
+            dynamic_res_ = true;
+            gpu_budget_ms_ = std::stof(*it);
+        }
     }
 
+    // the compute shader replaces per-object parameters entirely
+    if (use_compute_) use_push_constants_ = false;
+
     init_workers();
 }
 
@@ -88,6 +158,16 @@ void Hologram::init_workers() {
         Worker *worker = new Worker(*this, i, object_begin, object_end);
         workers_.emplace_back(std::unique_ptr<Worker>(worker));
     }
+
+    if (sort_objects_) {
+        for (auto &entries : sort_entries_) entries.resize(sim_.objects().size());
+        sort_counts_.resize(worker_count);
+    }
+
+    if (cull_objects_) {
+        cull_grids_.resize(worker_count);
+        for (auto &worker : workers_) update_cull_grid(*worker);
+    }
 }
 
 void Hologram::attach_shell(Shell &sh) {
@@ -98,15 +178,75 @@ void Hologram::attach_shell(Shell &sh) {
     dev_ = ctx.dev;
     queue_ = ctx.game_queue;
     queue_family_ = ctx.game_queue_family;
+    compute_queue_ = ctx.compute_queue;
+    compute_queue_family_ = ctx.compute_queue_family;
+    transfer_queue_ = ctx.transfer_queue;
+    transfer_queue_family_ = ctx.transfer_queue_family;
     format_ = ctx.format.format;
 
     vk::GetPhysicalDeviceProperties(physical_dev_, &physical_dev_props_);
 
+    // the objects are simulated on the CPU instead
+    if (use_compute_ && compute_queue_family_ == VK_QUEUE_FAMILY_IGNORED) {
+        shell_->log(Shell::LOG_WARN, "cannot enable compute shader without a COMPUTE queue family");
+        use_compute_ = false;
+    }
+
     if (use_push_constants_ && sizeof(ShaderParamBlock) > physical_dev_props_.limits.maxPushConstantsSize) {
         shell_->log(Shell::LOG_WARN, "cannot enable push constants");
         use_push_constants_ = false;
     }
 
+    // order-independent transparency makes sorting pointless
+    if (sort_objects_ && use_oit_) {
+        shell_->log(Shell::LOG_WARN, "not sorting objects with order-independent transparency");
+        sort_objects_ = false;
+    }
+
+    // the compute shader owns the object positions
+    if (sort_objects_ && use_compute_) {
+        shell_->log(Shell::LOG_WARN, "cannot sort objects simulated by the compute shader");
+        sort_objects_ = false;
+    }
+
+    // culling needs the positions on the host and works on the worker's own objects rather than a sorted range
+    if (cull_objects_ && (use_compute_ || sort_objects_)) {
+        shell_->log(Shell::LOG_WARN, "cannot cull objects simulated by the compute shader or sorted");
+        cull_objects_ = false;
+    }
+
+    // only the uniform buffer path keeps all per-frame state out of the command buffers, and sorting or culling changes
+    // the draws
+    if (reuse_secondaries_ && (use_push_constants_ || use_compute_ || sort_objects_ || cull_objects_)) {
+        shell_->log(Shell::LOG_WARN, "cannot reuse secondary command buffers without uniform buffers or with sorting or culling");
+        reuse_secondaries_ = false;
+    }
+
+    // the render pass is timed on the GPU so that the paths can be compared
+    {
+        std::vector<VkQueueFamilyProperties> queues;
+        vk::get(physical_dev_, queues);
+        gpu_timestamps_ = queues[queue_family_].timestampValidBits != 0;
+    }
+
+    // the scaled scene is blitted to the swapchain images and the scale follows the GPU time, see copy_blit_image
+    if (dynamic_res_) {
+        VkSurfaceCapabilitiesKHR caps;
+        vk::assert_success(vk::GetPhysicalDeviceSurfaceCapabilitiesKHR(physical_dev_, ctx.surface, &caps));
+
+        VkFormatProperties format_props;
+        vk::GetPhysicalDeviceFormatProperties(physical_dev_, format_, &format_props);
+        const VkFormatFeatureFlags blit_features =
+            VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+        if (!(caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+            (format_props.optimalTilingFeatures & blit_features) != blit_features || !gpu_timestamps_) {
+            shell_->log(Shell::LOG_WARN, "cannot scale the resolution without blits to the swapchain or timestamps");
+            dynamic_res_ = false;
+        }
+    }
+    settings_.swapchain_transfer_dst = dynamic_res_;
+
     VkPhysicalDeviceMemoryProperties mem_props;
     vk::GetPhysicalDeviceMemoryProperties(physical_dev_, &mem_props);
     mem_flags_.reserve(mem_props.memoryTypeCount);
@@ -119,23 +259,37 @@ void Hologram::attach_shell(Shell &sh) {
     create_descriptor_set_layout();
     create_pipeline_layout();
     create_pipeline();
+    if (use_oit_) create_oit_pipeline();
 
-    create_frame_data(2);
+    if (use_compute_) {
+        create_compute_pipeline();
+        create_object_buffer();
+        compute_ticks_ = 0;
+    }
+
+    create_frame_data(settings_.frames_in_flight);
 
     render_pass_begin_info_.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_begin_info_.renderPass = render_pass_;
-    render_pass_begin_info_.clearValueCount = 1;
-    render_pass_begin_info_.pClearValues = &render_pass_clear_value_;
+    // the background, no accumulation and full revealage
+    render_pass_clear_values_[0].color = {{0.0f, 0.1f, 0.2f, 1.0f}};
+    render_pass_clear_values_[1].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    render_pass_clear_values_[2].color = {{1.0f, 0.0f, 0.0f, 0.0f}};
+
+    render_pass_begin_info_.clearValueCount = use_oit_ ? 3 : 1;
+    render_pass_begin_info_.pClearValues = render_pass_clear_values_.data();
 
     primary_cmd_begin_info_.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     primary_cmd_begin_info_.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    // we will render to the swapchain images
-    primary_cmd_submit_wait_stages_ = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // we will render (or only blit) to the swapchain images, and read the instances from the compute queue
+    primary_cmd_submit_wait_stages_[0] =
+        dynamic_res_ ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    primary_cmd_submit_wait_stages_[1] = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
 
     primary_cmd_submit_info_.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    primary_cmd_submit_info_.waitSemaphoreCount = 1;
-    primary_cmd_submit_info_.pWaitDstStageMask = &primary_cmd_submit_wait_stages_;
+    primary_cmd_submit_info_.waitSemaphoreCount = use_compute_ ? 2 : 1;
+    primary_cmd_submit_info_.pWaitDstStageMask = primary_cmd_submit_wait_stages_;
     primary_cmd_submit_info_.commandBufferCount = 1;
     primary_cmd_submit_info_.signalSemaphoreCount = 1;
 
@@ -151,12 +305,33 @@ void Hologram::detach_shell() {
 
     destroy_frame_data();
 
-    vk::DestroyPipeline(dev_, pipeline_, nullptr);
-    vk::DestroyPipelineLayout(dev_, pipeline_layout_, nullptr);
-    if (!use_push_constants_) vk::DestroyDescriptorSetLayout(dev_, desc_set_layout_, nullptr);
-    vk::DestroyShaderModule(dev_, fs_, nullptr);
-    vk::DestroyShaderModule(dev_, vs_, nullptr);
-    vk::DestroyRenderPass(dev_, render_pass_, nullptr);
+    // destroyed once the frames using them are done, or when the shell flushes the queue on an idle device
+    DeletionQueue &deletion_queue = *shell_->context().deletion_queue;
+
+    if (use_compute_) {
+        deletion_queue.push(DeletionQueue::TYPE_BUFFER, (uint64_t)object_buf_);
+        deletion_queue.push(DeletionQueue::TYPE_DEVICE_MEMORY, (uint64_t)object_mem_);
+
+        deletion_queue.push(DeletionQueue::TYPE_PIPELINE, (uint64_t)compute_pipeline_);
+        deletion_queue.push(DeletionQueue::TYPE_PIPELINE_LAYOUT, (uint64_t)compute_pipeline_layout_);
+        deletion_queue.push(DeletionQueue::TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)compute_desc_set_layout_);
+        deletion_queue.push(DeletionQueue::TYPE_SHADER_MODULE, (uint64_t)cs_);
+    }
+
+    if (use_oit_) {
+        deletion_queue.push(DeletionQueue::TYPE_PIPELINE, (uint64_t)oit_pipeline_);
+        deletion_queue.push(DeletionQueue::TYPE_PIPELINE_LAYOUT, (uint64_t)oit_pipeline_layout_);
+        deletion_queue.push(DeletionQueue::TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)oit_desc_set_layout_);
+        deletion_queue.push(DeletionQueue::TYPE_SHADER_MODULE, (uint64_t)composite_fs_);
+        deletion_queue.push(DeletionQueue::TYPE_SHADER_MODULE, (uint64_t)composite_vs_);
+    }
+
+    deletion_queue.push(DeletionQueue::TYPE_PIPELINE, (uint64_t)pipeline_);
+    deletion_queue.push(DeletionQueue::TYPE_PIPELINE_LAYOUT, (uint64_t)pipeline_layout_);
+    if (!use_push_constants_) deletion_queue.push(DeletionQueue::TYPE_DESCRIPTOR_SET_LAYOUT, (uint64_t)desc_set_layout_);
+    deletion_queue.push(DeletionQueue::TYPE_SHADER_MODULE, (uint64_t)fs_);
+    deletion_queue.push(DeletionQueue::TYPE_SHADER_MODULE, (uint64_t)vs_);
+    deletion_queue.push(DeletionQueue::TYPE_RENDER_PASS, (uint64_t)render_pass_);
 
     delete meshes_;
 
@@ -164,13 +339,19 @@ void Hologram::detach_shell() {
 }
 
 void Hologram::create_render_pass() {
+    if (use_oit_) {
+        create_oit_render_pass();
+        return;
+    }
+
     VkAttachmentDescription attachment = {};
     attachment.format = format_;
     attachment.samples = VK_SAMPLE_COUNT_1_BIT;
     attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // with dynamic_res_, the scene target is blitted afterwards
+    attachment.finalLayout = dynamic_res_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference attachment_ref = {};
     attachment_ref.attachment = 0;
@@ -182,14 +363,26 @@ void Hologram::create_render_pass() {
     subpass.pColorAttachments = &attachment_ref;
 
     // Subpass dependency to wait for wsi image acquired semaphore before starting layout transition
-    VkSubpassDependency subpass_dependency = {};
-    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpass_dependency.dstSubpass = 0;
-    subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpass_dependency.srcAccessMask = 0;
-    subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpass_dependency.dependencyFlags = 0;
+    VkSubpassDependency subpass_dependencies[2] = {};
+    subpass_dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpass_dependencies[0].dstSubpass = 0;
+    subpass_dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependencies[0].srcAccessMask = 0;
+    subpass_dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpass_dependencies[0].dependencyFlags = 0;
+
+    // or, with dynamic_res_, for the blit out of the scene target before and after
+    if (dynamic_res_) {
+        subpass_dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        subpass_dependencies[1].srcSubpass = 0;
+        subpass_dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        subpass_dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        subpass_dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        subpass_dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        subpass_dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    }
 
     VkRenderPassCreateInfo render_pass_info = {};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -197,8 +390,93 @@ void Hologram::create_render_pass() {
     render_pass_info.pAttachments = &attachment;
     render_pass_info.subpassCount = 1;
     render_pass_info.pSubpasses = &subpass;
-    render_pass_info.dependencyCount = 1;
-    render_pass_info.pDependencies = &subpass_dependency;
+    render_pass_info.dependencyCount = dynamic_res_ ? 2 : 1;
+    render_pass_info.pDependencies = subpass_dependencies;
+
+    vk::assert_success(vk::CreateRenderPass(dev_, &render_pass_info, nullptr, &render_pass_));
+}
+
+void Hologram::create_oit_render_pass() {
+    std::array<VkAttachmentDescription, 3> attachments = {};
+    attachments[0].format = format_;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = dynamic_res_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    // the accumulation targets never leave the render pass
+    attachments[1] = attachments[0];
+    attachments[1].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[2] = attachments[1];
+    attachments[2].format = VK_FORMAT_R16_SFLOAT;
+
+    const VkAttachmentReference accum_refs[2] = {
+        {1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+    };
+    const VkAttachmentReference input_refs[2] = {
+        {1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        {2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+    };
+    const VkAttachmentReference color_ref = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    // accumulate the objects, then composite them over the background
+    std::array<VkSubpassDescription, 2> subpasses = {};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = 2;
+    subpasses[0].pColorAttachments = accum_refs;
+    subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[1].inputAttachmentCount = 2;
+    subpasses[1].pInputAttachments = input_refs;
+    subpasses[1].colorAttachmentCount = 1;
+    subpasses[1].pColorAttachments = &color_ref;
+
+    std::array<VkSubpassDependency, 4> dependencies = {};
+    // the previous frame may still be reading the accumulation targets
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = 1;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // wait for wsi image acquired semaphore before the swapchain image transitions
+    dependencies[2].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[2].dstSubpass = 1;
+    dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[2].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[2].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // or, with dynamic_res_, for the blit out of the scene target before and after
+    if (dynamic_res_) {
+        dependencies[2].srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        dependencies[3].srcSubpass = 1;
+        dependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[3].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[3].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[3].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    }
+
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+    render_pass_info.pAttachments = attachments.data();
+    render_pass_info.subpassCount = static_cast<uint32_t>(subpasses.size());
+    render_pass_info.pSubpasses = subpasses.data();
+    render_pass_info.dependencyCount = dynamic_res_ ? 4 : 3;
+    render_pass_info.pDependencies = dependencies.data();
 
     vk::assert_success(vk::CreateRenderPass(dev_, &render_pass_info, nullptr, &render_pass_));
 }
@@ -210,6 +488,10 @@ void Hologram::create_shader_modules() {
 #include "Hologram.push_constant.vert.h"
         sh_info.codeSize = sizeof(Hologram_push_constant_vert);
         sh_info.pCode = Hologram_push_constant_vert;
+    } else if (use_compute_) {
+#include "Hologram.compute.vert.h"
+        sh_info.codeSize = sizeof(Hologram_compute_vert);
+        sh_info.pCode = Hologram_compute_vert;
     } else {
 #include "Hologram.vert.h"
         sh_info.codeSize = sizeof(Hologram_vert);
@@ -217,9 +499,15 @@ void Hologram::create_shader_modules() {
     }
     vk::assert_success(vk::CreateShaderModule(dev_, &sh_info, nullptr, &vs_));
 
+    if (use_oit_) {
+#include "Hologram.oit.frag.h"
+        sh_info.codeSize = sizeof(Hologram_oit_frag);
+        sh_info.pCode = Hologram_oit_frag;
+    } else {
 #include "Hologram.frag.h"
-    sh_info.codeSize = sizeof(Hologram_frag);
-    sh_info.pCode = Hologram_frag;
+        sh_info.codeSize = sizeof(Hologram_frag);
+        sh_info.pCode = Hologram_frag;
+    }
     vk::assert_success(vk::CreateShaderModule(dev_, &sh_info, nullptr, &fs_));
 }
 
@@ -228,7 +516,7 @@ void Hologram::create_descriptor_set_layout() {
 
     VkDescriptorSetLayoutBinding layout_binding = {};
     layout_binding.binding = 0;
-    layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    layout_binding.descriptorType = use_compute_ ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     layout_binding.descriptorCount = 1;
     layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -258,6 +546,16 @@ void Hologram::create_pipeline_layout() {
         pipeline_layout_info.pSetLayouts = &desc_set_layout_;
     }
 
+    // only view_projection is not in the instance buffer
+    if (use_compute_) {
+        push_const_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        push_const_range.offset = 0;
+        push_const_range.size = sizeof(camera_.view_projection);
+
+        pipeline_layout_info.pushConstantRangeCount = 1;
+        pipeline_layout_info.pPushConstantRanges = &push_const_range;
+    }
+
     vk::assert_success(vk::CreatePipelineLayout(dev_, &pipeline_layout_info, nullptr, &pipeline_layout_));
 }
 
@@ -307,11 +605,31 @@ void Hologram::create_pipeline() {
     blend_attachment.colorWriteMask =
         VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
+    // with use_oit_, colors are summed and revealage is multiplied by (1 - alpha)
+    std::array<VkPipelineColorBlendAttachmentState, 2> oit_blend_attachments = {};
+    oit_blend_attachments[0].blendEnable = true;
+    oit_blend_attachments[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    oit_blend_attachments[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    oit_blend_attachments[0].colorBlendOp = VK_BLEND_OP_ADD;
+    oit_blend_attachments[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    oit_blend_attachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    oit_blend_attachments[0].alphaBlendOp = VK_BLEND_OP_ADD;
+    oit_blend_attachments[0].colorWriteMask = blend_attachment.colorWriteMask;
+    oit_blend_attachments[1] = oit_blend_attachments[0];
+    oit_blend_attachments[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    oit_blend_attachments[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+    oit_blend_attachments[1].colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+
     VkPipelineColorBlendStateCreateInfo blend_info = {};
     blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     blend_info.logicOpEnable = false;
-    blend_info.attachmentCount = 1;
-    blend_info.pAttachments = &blend_attachment;
+    if (use_oit_) {
+        blend_info.attachmentCount = static_cast<uint32_t>(oit_blend_attachments.size());
+        blend_info.pAttachments = oit_blend_attachments.data();
+    } else {
+        blend_info.attachmentCount = 1;
+        blend_info.pAttachments = &blend_attachment;
+    }
 
     std::array<VkDynamicState, 2> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
     struct VkPipelineDynamicStateCreateInfo dynamic_info = {};
@@ -338,36 +656,331 @@ void Hologram::create_pipeline() {
     vk::assert_success(vk::CreateGraphicsPipelines(dev_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline_));
 }
 
+void Hologram::create_oit_pipeline() {
+    VkShaderModuleCreateInfo sh_info = {};
+    sh_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+#include "Hologram.composite.vert.h"
+    sh_info.codeSize = sizeof(Hologram_composite_vert);
+    sh_info.pCode = Hologram_composite_vert;
+    vk::assert_success(vk::CreateShaderModule(dev_, &sh_info, nullptr, &composite_vs_));
+
+#include "Hologram.composite.frag.h"
+    sh_info.codeSize = sizeof(Hologram_composite_frag);
+    sh_info.pCode = Hologram_composite_frag;
+    vk::assert_success(vk::CreateShaderModule(dev_, &sh_info, nullptr, &composite_fs_));
+
+    // accumulation and revealage
+    std::array<VkDescriptorSetLayoutBinding, 2> layout_bindings = {};
+    for (uint32_t i = 0; i < layout_bindings.size(); i++) {
+        layout_bindings[i].binding = i;
+        layout_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        layout_bindings[i].descriptorCount = 1;
+        layout_bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+    layout_info.pBindings = layout_bindings.data();
+    vk::assert_success(vk::CreateDescriptorSetLayout(dev_, &layout_info, nullptr, &oit_desc_set_layout_));
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &oit_desc_set_layout_;
+    vk::assert_success(vk::CreatePipelineLayout(dev_, &pipeline_layout_info, nullptr, &oit_pipeline_layout_));
+
+    VkPipelineShaderStageCreateInfo stage_info[2] = {};
+    stage_info[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage_info[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stage_info[0].module = composite_vs_;
+    stage_info[0].pName = "main";
+    stage_info[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage_info[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stage_info[1].module = composite_fs_;
+    stage_info[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {};
+    input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_info = {};
+    viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    // both dynamic
+    viewport_info.viewportCount = 1;
+    viewport_info.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rast_info = {};
+    rast_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rast_info.polygonMode = VK_POLYGON_MODE_FILL;
+    rast_info.cullMode = VK_CULL_MODE_NONE;
+    rast_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rast_info.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample_info = {};
+    multisample_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // the averaged color over the background by total coverage
+    VkPipelineColorBlendAttachmentState blend_attachment = {};
+    blend_attachment.blendEnable = true;
+    blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo blend_info = {};
+    blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend_info.attachmentCount = 1;
+    blend_info.pAttachments = &blend_attachment;
+
+    std::array<VkDynamicState, 2> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_info = {};
+    dynamic_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_info.dynamicStateCount = (uint32_t)dynamic_states.size();
+    dynamic_info.pDynamicStates = dynamic_states.data();
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stage_info;
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly_info;
+    pipeline_info.pViewportState = &viewport_info;
+    pipeline_info.pRasterizationState = &rast_info;
+    pipeline_info.pMultisampleState = &multisample_info;
+    pipeline_info.pColorBlendState = &blend_info;
+    pipeline_info.pDynamicState = &dynamic_info;
+    pipeline_info.layout = oit_pipeline_layout_;
+    pipeline_info.renderPass = render_pass_;
+    pipeline_info.subpass = 1;
+    vk::assert_success(vk::CreateGraphicsPipelines(dev_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &oit_pipeline_));
+}
+
+void Hologram::create_compute_pipeline() {
+    VkShaderModuleCreateInfo sh_info = {};
+    sh_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+#include "Hologram.comp.h"
+    sh_info.codeSize = sizeof(Hologram_comp);
+    sh_info.pCode = Hologram_comp;
+    vk::assert_success(vk::CreateShaderModule(dev_, &sh_info, nullptr, &cs_));
+
+    // objects and instances
+    std::array<VkDescriptorSetLayoutBinding, 2> layout_bindings = {};
+    for (uint32_t i = 0; i < layout_bindings.size(); i++) {
+        layout_bindings[i].binding = i;
+        layout_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layout_bindings[i].descriptorCount = 1;
+        layout_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+    layout_info.pBindings = layout_bindings.data();
+
+    vk::assert_success(vk::CreateDescriptorSetLayout(dev_, &layout_info, nullptr, &compute_desc_set_layout_));
+
+    VkPushConstantRange push_const_range = {};
+    push_const_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_const_range.offset = 0;
+    push_const_range.size = sizeof(ComputeParamBlock);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &compute_desc_set_layout_;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_const_range;
+
+    vk::assert_success(vk::CreatePipelineLayout(dev_, &pipeline_layout_info, nullptr, &compute_pipeline_layout_));
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = cs_;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = compute_pipeline_layout_;
+    vk::assert_success(vk::CreateComputePipelines(dev_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &compute_pipeline_));
+}
+
+void Hologram::create_object_buffer() {
+    const auto &objects = sim_.objects();
+
+    // the rest of Animation and Path is seeded by the compute shader on its first dispatch
+    std::vector<ObjectBlock> blocks(objects.size(), ObjectBlock());
+    for (size_t i = 0; i < objects.size(); i++) {
+        const auto &obj = objects[i];
+        auto &block = blocks[i];
+
+        block.angle_scale[0] = obj.animation.data().angle;
+        block.angle_scale[1] = obj.animation.data().scale;
+        memcpy(block.light_pos, glm::value_ptr(glm::vec4(obj.light_pos, 1.0f)), sizeof(block.light_pos));
+        memcpy(block.light_color, glm::value_ptr(glm::vec4(obj.light_color, 1.0f)), sizeof(block.light_color));
+
+        // no subpath yet
+        block.subpath[1] = -1.0f;
+        block.subpath[2] = -1.0f;
+
+        block.rng[0] = sim_.rng_seed();
+        block.rng[1] = static_cast<uint32_t>(i);
+    }
+
+    const VkDeviceSize size = sizeof(ObjectBlock) * blocks.size();
+
+    // written by the transfer queue once and by the compute queue afterwards
+    const uint32_t queue_families[2] = {compute_queue_family_, transfer_queue_family_};
+
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.size = size;
+    buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (compute_queue_family_ != transfer_queue_family_) {
+        buf_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buf_info.queueFamilyIndexCount = 2;
+        buf_info.pQueueFamilyIndices = queue_families;
+    } else {
+        buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &object_buf_));
+
+    VkMemoryRequirements mem_reqs;
+    vk::GetBufferMemoryRequirements(dev_, object_buf_, &mem_reqs);
+
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = mem_reqs.size;
+    mem_info.memoryTypeIndex = find_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &object_mem_));
+    vk::assert_success(vk::BindBufferMemory(dev_, object_buf_, object_mem_, 0));
+
+    // stage the initial state
+    VkBuffer staging_buf;
+    buf_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buf_info.queueFamilyIndexCount = 0;
+    buf_info.pQueueFamilyIndices = nullptr;
+    vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &staging_buf));
+
+    vk::GetBufferMemoryRequirements(dev_, staging_buf, &mem_reqs);
+
+    VkDeviceMemory staging_mem;
+    mem_info.allocationSize = mem_reqs.size;
+    mem_info.memoryTypeIndex = find_memory_type(mem_reqs.memoryTypeBits,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &staging_mem));
+    vk::assert_success(vk::BindBufferMemory(dev_, staging_buf, staging_mem, 0));
+
+    void *ptr;
+    vk::assert_success(vk::MapMemory(dev_, staging_mem, 0, VK_WHOLE_SIZE, 0, &ptr));
+    memcpy(ptr, blocks.data(), static_cast<size_t>(size));
+    vk::UnmapMemory(dev_, staging_mem);
+
+    VkCommandPoolCreateInfo cmd_pool_info = {};
+    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    cmd_pool_info.queueFamilyIndex = transfer_queue_family_;
+
+    VkCommandPool cmd_pool;
+    vk::assert_success(vk::CreateCommandPool(dev_, &cmd_pool_info, nullptr, &cmd_pool));
+
+    VkCommandBufferAllocateInfo cmd_info = {};
+    cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_info.commandPool = cmd_pool;
+    cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_info.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, &cmd));
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vk::BeginCommandBuffer(cmd, &begin_info);
+
+    VkBufferCopy region = {};
+    region.size = size;
+    vk::CmdCopyBuffer(cmd, staging_buf, object_buf_, 1, &region);
+
+    vk::EndCommandBuffer(cmd);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+    vk::assert_success(vk::QueueSubmit(transfer_queue_, 1, &submit_info, VK_NULL_HANDLE));
+    vk::assert_success(vk::QueueWaitIdle(transfer_queue_));
+
+    vk::DestroyCommandPool(dev_, cmd_pool, nullptr);
+    vk::DestroyBuffer(dev_, staging_buf, nullptr);
+    vk::FreeMemory(dev_, staging_mem, nullptr);
+}
+
 void Hologram::create_frame_data(int count) {
     frame_data_.resize(count);
 
     create_fences();
     create_command_buffers();
 
-    if (!use_push_constants_) {
+    if (use_compute_) {
+        create_instance_buffers();
+        create_descriptor_sets();
+    } else if (!use_push_constants_) {
         create_buffers();
         create_buffer_memory();
         create_descriptor_sets();
     }
 
+    if (gpu_timestamps_) {
+        VkQueryPoolCreateInfo query_pool_info = {};
+        query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_pool_info.queryCount = 2 * count;
+        vk::assert_success(vk::CreateQueryPool(dev_, &query_pool_info, nullptr, &timestamp_pool_));
+    }
+
     frame_data_index_ = 0;
 }
 
 void Hologram::destroy_frame_data() {
-    if (!use_push_constants_) {
-        vk::DestroyDescriptorPool(dev_, desc_pool_, nullptr);
+    // the frames may still be in flight
+    DeletionQueue &deletion_queue = *shell_->context().deletion_queue;
 
-        vk::UnmapMemory(dev_, frame_data_mem_);
-        vk::FreeMemory(dev_, frame_data_mem_, nullptr);
+    if (gpu_timestamps_) deletion_queue.push(DeletionQueue::TYPE_QUERY_POOL, (uint64_t)timestamp_pool_);
 
-        for (auto &data : frame_data_) vk::DestroyBuffer(dev_, data.buf, nullptr);
+    if (!use_push_constants_) deletion_queue.push(DeletionQueue::TYPE_DESCRIPTOR_POOL, (uint64_t)desc_pool_);
+
+    if (!use_push_constants_ && !use_compute_) {
+        for (auto &data : frame_data_) deletion_queue.push(DeletionQueue::TYPE_BUFFER, (uint64_t)data.buf);
+
+        // freeing unmaps it; it is not written to anymore either way
+        deletion_queue.push(DeletionQueue::TYPE_DEVICE_MEMORY, (uint64_t)frame_data_mem_);
     }
 
-    for (auto cmd_pool : worker_cmd_pools_) vk::DestroyCommandPool(dev_, cmd_pool, nullptr);
-    worker_cmd_pools_.clear();
-    vk::DestroyCommandPool(dev_, primary_cmd_pool_, nullptr);
+    if (use_compute_) {
+        for (auto &data : frame_data_) {
+            deletion_queue.push(DeletionQueue::TYPE_BUFFER, (uint64_t)data.instance_buf);
+            deletion_queue.push(DeletionQueue::TYPE_COMMAND_POOL, (uint64_t)data.compute_cmd_pool);
+            deletion_queue.push(DeletionQueue::TYPE_SEMAPHORE, (uint64_t)data.compute_semaphore);
+        }
 
-    for (auto &data : frame_data_) vk::DestroyFence(dev_, data.fence, nullptr);
+        deletion_queue.push(DeletionQueue::TYPE_DEVICE_MEMORY, (uint64_t)instance_mem_);
+    }
+
+    for (auto &data : frame_data_) {
+        for (auto cmd_pool : data.worker_cmd_pools) deletion_queue.push(DeletionQueue::TYPE_COMMAND_POOL, (uint64_t)cmd_pool);
+        deletion_queue.push(DeletionQueue::TYPE_COMMAND_POOL, (uint64_t)data.primary_cmd_pool);
+
+        deletion_queue.push(DeletionQueue::TYPE_FENCE, (uint64_t)data.fence);
+    }
 
     frame_data_.clear();
 }
@@ -378,48 +991,70 @@ void Hologram::create_fences() {
     fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
     for (auto &data : frame_data_) vk::assert_success(vk::CreateFence(dev_, &fence_info, nullptr, &data.fence));
+
+    if (!use_compute_) return;
+
+    // and semaphores for the primary to wait for the compute submission
+    VkSemaphoreCreateInfo sem_info = {};
+    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (auto &data : frame_data_) vk::assert_success(vk::CreateSemaphore(dev_, &sem_info, nullptr, &data.compute_semaphore));
 }
 
 void Hologram::create_command_buffers() {
     VkCommandPoolCreateInfo cmd_pool_info = {};
     cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     cmd_pool_info.queueFamilyIndex = queue_family_;
 
     VkCommandBufferAllocateInfo cmd_info = {};
     cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmd_info.commandBufferCount = static_cast<uint32_t>(frame_data_.size());
+    cmd_info.commandBufferCount = 1;
 
-    // create command pools and buffers
-    std::vector<VkCommandPool> cmd_pools(workers_.size() + 1, VK_NULL_HANDLE);
-    std::vector<std::vector<VkCommandBuffer>> cmds_vec(workers_.size() + 1,
-                                                       std::vector<VkCommandBuffer>(frame_data_.size(), VK_NULL_HANDLE));
-    for (size_t i = 0; i < cmd_pools.size(); i++) {
-        auto &cmd_pool = cmd_pools[i];
-        auto &cmds = cmds_vec[i];
+    // reused secondaries are long-lived
+    VkCommandPoolCreateInfo worker_cmd_pool_info = cmd_pool_info;
+    if (reuse_secondaries_) worker_cmd_pool_info.flags = 0;
 
-        vk::assert_success(vk::CreateCommandPool(dev_, &cmd_pool_info, nullptr, &cmd_pool));
+    // create a command pool and a buffer for each (worker, frame data) pair and for each primary
+    for (auto &data : frame_data_) {
+        data.worker_cmd_pools.resize(workers_.size(), VK_NULL_HANDLE);
+        data.worker_cmds.resize(workers_.size(), VK_NULL_HANDLE);
+        data.worker_cmds_valid = false;
+        data.timestamps_valid = false;
+
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        for (size_t i = 0; i < workers_.size(); i++) {
+            vk::assert_success(vk::CreateCommandPool(dev_, &worker_cmd_pool_info, nullptr, &data.worker_cmd_pools[i]));
 
-        cmd_info.commandPool = cmd_pool;
-        cmd_info.level = (cmd_pool == cmd_pools.back()) ? VK_COMMAND_BUFFER_LEVEL_PRIMARY : VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            cmd_info.commandPool = data.worker_cmd_pools[i];
+            vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, &data.worker_cmds[i]));
+        }
 
-        vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, cmds.data()));
+        vk::assert_success(vk::CreateCommandPool(dev_, &cmd_pool_info, nullptr, &data.primary_cmd_pool));
+
+        cmd_info.commandPool = data.primary_cmd_pool;
+        cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, &data.primary_cmd));
     }
 
-    // update frame_data_
-    for (size_t i = 0; i < frame_data_.size(); i++) {
-        for (const auto &cmds : cmds_vec) {
-            if (cmds == cmds_vec.back()) {
-                frame_data_[i].primary_cmd = cmds[i];
-            } else {
-                frame_data_[i].worker_cmds.push_back(cmds[i]);
-            }
-        }
+    if (!use_compute_) return;
+
+    cmd_pool_info.queueFamilyIndex = compute_queue_family_;
+    for (auto &data : frame_data_) {
+        vk::assert_success(vk::CreateCommandPool(dev_, &cmd_pool_info, nullptr, &data.compute_cmd_pool));
+
+        cmd_info.commandPool = data.compute_cmd_pool;
+        vk::assert_success(vk::AllocateCommandBuffers(dev_, &cmd_info, &data.compute_cmd));
     }
+}
 
-    primary_cmd_pool_ = cmd_pools.back();
-    cmd_pools.pop_back();
-    worker_cmd_pools_ = cmd_pools;
+void Hologram::reset_command_buffers(FrameData &data) {
+    // recycle everything recorded for this frame data at once instead of resetting buffer by buffer
+    if (!data.worker_cmds_valid) {
+        for (auto cmd_pool : data.worker_cmd_pools) vk::assert_success(vk::ResetCommandPool(dev_, cmd_pool, 0));
+    }
+    vk::assert_success(vk::ResetCommandPool(dev_, data.primary_cmd_pool, 0));
+    if (use_compute_) vk::assert_success(vk::ResetCommandPool(dev_, data.compute_cmd_pool, 0));
 }
 
 void Hologram::create_buffers() {
@@ -476,15 +1111,59 @@ void Hologram::create_buffer_memory() {
     }
 }
 
+void Hologram::create_instance_buffers() {
+    // written by the compute queue and read by the game queue
+    const uint32_t queue_families[2] = {queue_family_, compute_queue_family_};
+
+    VkBufferCreateInfo buf_info = {};
+    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buf_info.size = sizeof(InstanceBlock) * sim_.objects().size();
+    buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    if (queue_family_ != compute_queue_family_) {
+        buf_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buf_info.queueFamilyIndexCount = 2;
+        buf_info.pQueueFamilyIndices = queue_families;
+    } else {
+        buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    for (auto &data : frame_data_) vk::assert_success(vk::CreateBuffer(dev_, &buf_info, nullptr, &data.instance_buf));
+
+    VkMemoryRequirements mem_reqs;
+    vk::GetBufferMemoryRequirements(dev_, frame_data_[0].instance_buf, &mem_reqs);
+
+    VkDeviceSize aligned_size = mem_reqs.size;
+    if (aligned_size % mem_reqs.alignment) aligned_size += mem_reqs.alignment - (aligned_size % mem_reqs.alignment);
+
+    // never touched by the host
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = aligned_size * (frame_data_.size() - 1) + mem_reqs.size;
+    mem_info.memoryTypeIndex = find_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &instance_mem_));
+
+    VkDeviceSize offset = 0;
+    for (auto &data : frame_data_) {
+        vk::BindBufferMemory(dev_, data.instance_buf, instance_mem_, offset);
+        offset += aligned_size;
+    }
+}
+
 void Hologram::create_descriptor_sets() {
+    const VkDescriptorType desc_type = use_compute_ ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+
+    // with use_compute_, each frame data also has a set of two for the compute shader
+    const uint32_t set_count = use_compute_ ? 2 : 1;
+    const uint32_t desc_count = use_compute_ ? 3 : 1;
+
     VkDescriptorPoolSize desc_pool_size = {};
-    desc_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    desc_pool_size.type = desc_type;
     assert(frame_data_.size() <= UINT32_MAX);
-    desc_pool_size.descriptorCount = static_cast<uint32_t>(frame_data_.size());
+    desc_pool_size.descriptorCount = desc_count * static_cast<uint32_t>(frame_data_.size());
 
     VkDescriptorPoolCreateInfo desc_pool_info = {};
     desc_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    desc_pool_info.maxSets = static_cast<uint32_t>(frame_data_.size());
+    desc_pool_info.maxSets = set_count * static_cast<uint32_t>(frame_data_.size());
     desc_pool_info.poolSizeCount = 1;
     desc_pool_info.pPoolSizes = &desc_pool_size;
 
@@ -511,7 +1190,7 @@ void Hologram::create_descriptor_sets() {
         data.desc_set = desc_sets[i];
 
         VkDescriptorBufferInfo desc_buf = {};
-        desc_buf.buffer = data.buf;
+        desc_buf.buffer = use_compute_ ? data.instance_buf : data.buf;
         desc_buf.offset = 0;
         desc_buf.range = VK_WHOLE_SIZE;
         desc_bufs[i] = desc_buf;
@@ -522,12 +1201,55 @@ void Hologram::create_descriptor_sets() {
         desc_write.dstBinding = 0;
         desc_write.dstArrayElement = 0;
         desc_write.descriptorCount = 1;
-        desc_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        desc_write.descriptorType = desc_type;
         desc_write.pBufferInfo = &desc_bufs[i];
         desc_writes[i] = desc_write;
     }
 
     vk::UpdateDescriptorSets(dev_, static_cast<uint32_t>(desc_writes.size()), desc_writes.data(), 0, nullptr);
+
+    if (!use_compute_) return;
+
+    set_layouts.assign(frame_data_.size(), compute_desc_set_layout_);
+    vk::assert_success(vk::AllocateDescriptorSets(dev_, &set_info, desc_sets.data()));
+
+    // objects and instances in consecutive bindings
+    std::vector<std::array<VkDescriptorBufferInfo, 2>> compute_desc_bufs(frame_data_.size());
+
+    for (size_t i = 0; i < frame_data_.size(); i++) {
+        auto &data = frame_data_[i];
+
+        data.compute_desc_set = desc_sets[i];
+
+        auto &bufs = compute_desc_bufs[i];
+        bufs[0].buffer = object_buf_;
+        bufs[1].buffer = data.instance_buf;
+        for (auto &buf : bufs) {
+            buf.offset = 0;
+            buf.range = VK_WHOLE_SIZE;
+        }
+
+        auto &desc_write = desc_writes[i];
+        desc_write.dstSet = data.compute_desc_set;
+        desc_write.descriptorCount = static_cast<uint32_t>(bufs.size());
+        desc_write.pBufferInfo = bufs.data();
+    }
+
+    vk::UpdateDescriptorSets(dev_, static_cast<uint32_t>(desc_writes.size()), desc_writes.data(), 0, nullptr);
+}
+
+uint32_t Hologram::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags flags) const {
+    for (uint32_t idx = 0; idx < mem_flags_.size(); idx++) {
+        if ((type_bits & (1 << idx)) && (mem_flags_[idx] & flags) == flags) return idx;
+    }
+
+    // DEVICE_LOCAL is only a preference
+    assert(!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+    for (uint32_t idx = 0; idx < mem_flags_.size(); idx++) {
+        if (type_bits & (1 << idx)) return idx;
+    }
+
+    throw std::runtime_error("failed to find a memory type");
 }
 
 void Hologram::attach_swapchain() {
@@ -537,39 +1259,73 @@ void Hologram::attach_swapchain() {
     prepare_framebuffers(ctx.swapchain);
 
     update_camera();
+
+    // the viewport is recorded in the secondaries
+    invalidate_secondaries();
 }
 
-void Hologram::detach_swapchain() {
-    for (auto fb : framebuffers_) vk::DestroyFramebuffer(dev_, fb, nullptr);
-    for (auto view : image_views_) vk::DestroyImageView(dev_, view, nullptr);
+void Hologram::invalidate_secondaries() {
+    for (auto &data : frame_data_) data.worker_cmds_valid = false;
+}
+
+bool Hologram::retire_swapchain() {
+    // frames in flight may still be drawing with these
+    DeletionQueue &deletion_queue = *shell_->context().deletion_queue;
+
+    for (auto fb : framebuffers_) deletion_queue.push(DeletionQueue::TYPE_FRAMEBUFFER, (uint64_t)fb);
+    for (auto view : image_views_) deletion_queue.push(DeletionQueue::TYPE_IMAGE_VIEW, (uint64_t)view);
+    for (auto targets : {&oit_accum_, &oit_revealage_, &scene_targets_}) {
+        for (const auto &target : *targets) {
+            deletion_queue.push(DeletionQueue::TYPE_IMAGE_VIEW, (uint64_t)target.view);
+            deletion_queue.push(DeletionQueue::TYPE_IMAGE, (uint64_t)target.image);
+            deletion_queue.push(DeletionQueue::TYPE_DEVICE_MEMORY, (uint64_t)target.mem, target.mem_size);
+        }
+        targets->clear();
+    }
+    if (use_oit_) deletion_queue.push(DeletionQueue::TYPE_DESCRIPTOR_POOL, (uint64_t)oit_desc_pool_);
 
     framebuffers_.clear();
     image_views_.clear();
+    oit_desc_sets_.clear();
     images_.clear();
+
+    return true;
+}
+
+void Hologram::detach_swapchain() {
+    // the shell flushes the deletion queue right after
+    retire_swapchain();
 }
 
 void Hologram::prepare_viewport(const VkExtent2D &extent) {
     extent_ = extent;
 
+    // with dynamic_res_, only the top-left render_scale_ of the targets is drawn and blitted
+    scissor_.offset = {0, 0};
+    scissor_.extent.width = std::max(static_cast<uint32_t>(extent_.width * render_scale_), 1u);
+    scissor_.extent.height = std::max(static_cast<uint32_t>(extent_.height * render_scale_), 1u);
+
     viewport_.x = 0.0f;
     viewport_.y = 0.0f;
-    viewport_.width = static_cast<float>(extent.width);
-    viewport_.height = static_cast<float>(extent.height);
+    viewport_.width = static_cast<float>(scissor_.extent.width);
+    viewport_.height = static_cast<float>(scissor_.extent.height);
     viewport_.minDepth = 0.0f;
     viewport_.maxDepth = 1.0f;
-
-    scissor_.offset = {0, 0};
-    scissor_.extent = extent_;
 }
 
 void Hologram::prepare_framebuffers(VkSwapchainKHR swapchain) {
     // get swapchain images
     vk::get(dev_, swapchain, images_);
 
+    if (use_oit_) prepare_oit_targets();
+    if (dynamic_res_) prepare_scene_targets();
+
     assert(framebuffers_.empty());
     image_views_.reserve(images_.size());
     framebuffers_.reserve(images_.size());
-    for (auto img : images_) {
+    for (size_t i = 0; i < images_.size(); i++) {
+        VkImage img = images_[i];
+
         VkImageViewCreateInfo view_info = {};
         view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         view_info.image = img;
@@ -583,11 +1339,14 @@ void Hologram::prepare_framebuffers(VkSwapchainKHR swapchain) {
         vk::assert_success(vk::CreateImageView(dev_, &view_info, nullptr, &view));
         image_views_.push_back(view);
 
+        const VkImageView attachments[3] = {dynamic_res_ ? scene_targets_[i].view : view, use_oit_ ? oit_accum_[i].view : VK_NULL_HANDLE,
+                                            use_oit_ ? oit_revealage_[i].view : VK_NULL_HANDLE};
+
         VkFramebufferCreateInfo fb_info = {};
         fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         fb_info.renderPass = render_pass_;
-        fb_info.attachmentCount = 1;
-        fb_info.pAttachments = &view;
+        fb_info.attachmentCount = use_oit_ ? 3 : 1;
+        fb_info.pAttachments = attachments;
         fb_info.width = extent_.width;
         fb_info.height = extent_.height;
         fb_info.layers = 1;
@@ -598,18 +1357,134 @@ void Hologram::prepare_framebuffers(VkSwapchainKHR swapchain) {
     }
 }
 
+void Hologram::prepare_oit_targets() {
+    const VkFormat formats[2] = {VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R16_SFLOAT};
+    std::vector<RenderTarget> *targets[2] = {&oit_accum_, &oit_revealage_};
+
+    // never stored, so lazily allocated memory is enough where there is any
+    for (int t = 0; t < 2; t++) {
+        targets[t]->resize(images_.size());
+        for (auto &target : *targets[t])
+            create_render_target(formats[t], VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                                                 VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                 VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, target);
+    }
+
+    VkDescriptorPoolSize desc_pool_size = {};
+    desc_pool_size.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    desc_pool_size.descriptorCount = 2 * static_cast<uint32_t>(images_.size());
+
+    VkDescriptorPoolCreateInfo desc_pool_info = {};
+    desc_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    desc_pool_info.maxSets = static_cast<uint32_t>(images_.size());
+    desc_pool_info.poolSizeCount = 1;
+    desc_pool_info.pPoolSizes = &desc_pool_size;
+    vk::assert_success(vk::CreateDescriptorPool(dev_, &desc_pool_info, nullptr, &oit_desc_pool_));
+
+    std::vector<VkDescriptorSetLayout> set_layouts(images_.size(), oit_desc_set_layout_);
+    VkDescriptorSetAllocateInfo set_info = {};
+    set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    set_info.descriptorPool = oit_desc_pool_;
+    set_info.descriptorSetCount = static_cast<uint32_t>(set_layouts.size());
+    set_info.pSetLayouts = set_layouts.data();
+
+    oit_desc_sets_.resize(images_.size());
+    vk::assert_success(vk::AllocateDescriptorSets(dev_, &set_info, oit_desc_sets_.data()));
+
+    std::vector<std::array<VkDescriptorImageInfo, 2>> desc_images(images_.size());
+    std::vector<VkWriteDescriptorSet> desc_writes(images_.size());
+    for (size_t i = 0; i < images_.size(); i++) {
+        auto &images = desc_images[i];
+        images[0].imageView = oit_accum_[i].view;
+        images[1].imageView = oit_revealage_[i].view;
+        for (auto &image : images) image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        auto &desc_write = desc_writes[i];
+        desc_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        desc_write.dstSet = oit_desc_sets_[i];
+        desc_write.dstBinding = 0;
+        desc_write.descriptorCount = static_cast<uint32_t>(images.size());
+        desc_write.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        desc_write.pImageInfo = images.data();
+    }
+
+    vk::UpdateDescriptorSets(dev_, static_cast<uint32_t>(desc_writes.size()), desc_writes.data(), 0, nullptr);
+}
+
+void Hologram::prepare_scene_targets() {
+    scene_targets_.resize(images_.size());
+    for (auto &target : scene_targets_)
+        create_render_target(format_, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target);
+}
+
+void Hologram::create_render_target(VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags mem_flags,
+                                    RenderTarget &target) {
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = {extent_.width, extent_.height, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    vk::assert_success(vk::CreateImage(dev_, &image_info, nullptr, &target.image));
+
+    VkMemoryRequirements mem_reqs;
+    vk::GetImageMemoryRequirements(dev_, target.image, &mem_reqs);
+
+    VkMemoryAllocateInfo mem_info = {};
+    mem_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    mem_info.allocationSize = mem_reqs.size;
+    mem_info.memoryTypeIndex = find_memory_type(mem_reqs.memoryTypeBits, mem_flags);
+    vk::assert_success(vk::AllocateMemory(dev_, &mem_info, nullptr, &target.mem));
+    target.mem_size = mem_reqs.size;
+    vk::assert_success(vk::BindImageMemory(dev_, target.image, target.mem, 0));
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = target.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = 1;
+    vk::assert_success(vk::CreateImageView(dev_, &view_info, nullptr, &target.view));
+}
+
 void Hologram::update_camera() {
     const glm::vec3 center(0.0f);
     const glm::vec3 up(0.f, 0.0f, 1.0f);
     const glm::mat4 view = glm::lookAt(camera_.eye_pos, center, up);
 
     float aspect = static_cast<float>(extent_.width) / static_cast<float>(extent_.height);
-    const glm::mat4 projection = glm::perspective(0.4f, aspect, 0.1f, 100.0f);
+    const glm::mat4 projection = glm::perspective(0.4f, aspect, camera_.z_near, camera_.z_far);
 
     // Vulkan clip space has inverted Y and half Z.
     const glm::mat4 clip(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f, 0.5f, 1.0f);
 
     camera_.view_projection = clip * projection * view;
+
+    // -w <= x <= w, -w <= y <= w and 0 <= z <= w
+    const glm::mat4 &m = camera_.view_projection;
+    cull_planes_ = {{
+        glm::row(m, 3) + glm::row(m, 0), glm::row(m, 3) - glm::row(m, 0), glm::row(m, 3) + glm::row(m, 1),
+        glm::row(m, 3) - glm::row(m, 1), glm::row(m, 2), glm::row(m, 3) - glm::row(m, 2),
+    }};
+    for (auto &plane : cull_planes_) plane /= glm::length(glm::vec3(plane));
+}
+
+void Hologram::update_object(const Simulation::Object &obj, FrameData &data) const {
+    ShaderParamBlock *params = reinterpret_cast<ShaderParamBlock *>(data.base + obj.frame_data_offset);
+    memcpy(params->light_pos, glm::value_ptr(obj.light_pos), sizeof(obj.light_pos));
+    memcpy(params->light_color, glm::value_ptr(obj.light_color), sizeof(obj.light_color));
+    memcpy(params->model, glm::value_ptr(obj.model), sizeof(obj.model));
+    memcpy(params->view_projection, glm::value_ptr(camera_.view_projection), sizeof(camera_.view_projection));
+    params->alpha = sim_fade_ ? obj.alpha : 0.5f;
 }
 
 void Hologram::draw_object(const Simulation::Object &obj, FrameData &data, VkCommandBuffer cmd) const {
@@ -623,12 +1498,7 @@ void Hologram::draw_object(const Simulation::Object &obj, FrameData &data, VkCom
 
         vk::CmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(params), &params);
     } else {
-        ShaderParamBlock *params = reinterpret_cast<ShaderParamBlock *>(data.base + obj.frame_data_offset);
-        memcpy(params->light_pos, glm::value_ptr(obj.light_pos), sizeof(obj.light_pos));
-        memcpy(params->light_color, glm::value_ptr(obj.light_color), sizeof(obj.light_color));
-        memcpy(params->model, glm::value_ptr(obj.model), sizeof(obj.model));
-        memcpy(params->view_projection, glm::value_ptr(camera_.view_projection), sizeof(camera_.view_projection));
-        params->alpha = sim_fade_ ? obj.alpha : 0.5f;
+        update_object(obj, data);
 
         vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &data.desc_set, 1,
                                   &obj.frame_data_offset);
@@ -639,16 +1509,124 @@ void Hologram::draw_object(const Simulation::Object &obj, FrameData &data, VkCom
 
 void Hologram::update_simulation(const Worker &worker) {
     sim_.update(worker.tick_interval_, worker.object_begin_, worker.object_end_);
+    if (cull_objects_) update_cull_grid(worker);
+}
+
+void Hologram::update_cull_grid(const Worker &worker) {
+    auto &grid = cull_grids_[worker.index_];
+    const int dim = CullGrid::dim;
+
+    grid.cell_begin.fill(0);
+    grid.cell_min.fill(glm::vec3(FLT_MAX));
+    grid.cell_max.fill(glm::vec3(-FLT_MAX));
+    grid.objects.resize(worker.object_end_ - worker.object_begin_);
+    grid.object_cells.resize(worker.object_end_ - worker.object_begin_);
+
+    for (int i = worker.object_begin_; i < worker.object_end_; i++) {
+        const auto &obj = sim_.objects()[i];
+
+        // origins wrap around in [0, 2)^3 but the curves wander a bit past it, so the outer cells take the rest
+        const glm::ivec3 c = glm::clamp(glm::ivec3(obj.tick_pos[1] * (dim / 2.0f)), glm::ivec3(0), glm::ivec3(dim - 1));
+        const int cell = (c.z * dim + c.y) * dim + c.x;
+
+        grid.object_cells[i - worker.object_begin_] = static_cast<uint8_t>(cell);
+        grid.cell_begin[cell + 1]++;
+
+        // both ticks, so that the bounds hold for every interpolated frame until the next tick
+        const float radius = bounding_radius(obj);
+        grid.cell_min[cell] = glm::min(grid.cell_min[cell], glm::min(obj.tick_pos[0], obj.tick_pos[1]) - radius);
+        grid.cell_max[cell] = glm::max(grid.cell_max[cell], glm::max(obj.tick_pos[0], obj.tick_pos[1]) + radius);
+    }
+
+    for (int cell = 0; cell < CullGrid::cell_count; cell++) grid.cell_begin[cell + 1] += grid.cell_begin[cell];
+
+    std::array<uint32_t, CullGrid::cell_count> offsets;
+    std::copy(grid.cell_begin.begin(), grid.cell_begin.end() - 1, offsets.begin());
+    for (int i = worker.object_begin_; i < worker.object_end_; i++)
+        grid.objects[offsets[grid.object_cells[i - worker.object_begin_]]++] = i;
+}
+
+void Hologram::sort_objects() {
+    // 16-bit keys in two 8-bit LSD passes, with a handoff to the workers per phase
+    const SortStep steps[] = {SORT_KEYS, SORT_SCATTER_LOW, SORT_COUNT_HIGH, SORT_SCATTER_HIGH};
+    for (auto step : steps) {
+        if (step == SORT_SCATTER_LOW || step == SORT_SCATTER_HIGH) prefix_sort_counts();
+
+        for (auto &worker : workers_) worker->sort_objects(step);
+        for (auto &worker : workers_) worker->wait_idle();
+    }
+}
+
+void Hologram::prefix_sort_counts() {
+    // digit-major then worker-major keeps every pass stable
+    uint32_t offset = 0;
+    for (int digit = 0; digit < 256; digit++) {
+        for (auto &counts : sort_counts_) {
+            uint32_t count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+    }
+}
+
+void Hologram::sort_objects(Worker &worker) {
+    auto &counts = sort_counts_[worker.index_];
+
+    switch (worker.sort_step_) {
+        case SORT_KEYS: {
+            sim_.interpolate(sim_frame_pred_, worker.object_begin_, worker.object_end_);
+
+            // clip w is the view depth; farther objects get smaller keys and are drawn first
+            const glm::mat4 &vp = camera_.view_projection;
+            const float scale = 65535.0f / camera_.z_far;
+
+            counts.fill(0);
+            for (int i = worker.object_begin_; i < worker.object_end_; i++) {
+                const glm::vec4 &pos = sim_.objects()[i].model[3];
+                const float depth = vp[0][3] * pos.x + vp[1][3] * pos.y + vp[2][3] * pos.z + vp[3][3];
+
+                SortEntry &entry = sort_entries_[0][i];
+                entry.key = 65535 - static_cast<uint32_t>(glm::clamp(depth * scale, 0.0f, 65535.0f));
+                entry.index = static_cast<uint32_t>(i);
+                counts[entry.key & 0xff]++;
+            }
+        } break;
+        case SORT_SCATTER_LOW:
+        case SORT_SCATTER_HIGH: {
+            const int src = (worker.sort_step_ == SORT_SCATTER_LOW) ? 0 : 1;
+            const int shift = (worker.sort_step_ == SORT_SCATTER_LOW) ? 0 : 8;
+
+            for (int i = worker.object_begin_; i < worker.object_end_; i++) {
+                const SortEntry &entry = sort_entries_[src][i];
+                sort_entries_[1 - src][counts[(entry.key >> shift) & 0xff]++] = entry;
+            }
+        } break;
+        case SORT_COUNT_HIGH:
+            counts.fill(0);
+            for (int i = worker.object_begin_; i < worker.object_end_; i++) counts[sort_entries_[1][i].key >> 8]++;
+            break;
+    }
 }
 
 void Hologram::draw_objects(Worker &worker) {
     auto &data = frame_data_[frame_data_index_];
     auto cmd = data.worker_cmds[worker.index_];
 
+    // the compute shader does not keep the previous tick around, sort_objects has interpolated already, and culling
+    // interpolates only what is visible
+    if (!use_compute_ && !sort_objects_ && !cull_objects_) sim_.interpolate(sim_frame_pred_, worker.object_begin_, worker.object_end_);
+
+    // the recorded dynamic offsets and draws still hold, only the uniforms change
+    if (data.worker_cmds_valid) {
+        for (int i = worker.object_begin_; i < worker.object_end_; i++) update_object(sim_.objects()[i], data);
+        return;
+    }
+
     VkCommandBufferInheritanceInfo inherit_info = {};
     inherit_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
     inherit_info.renderPass = render_pass_;
-    inherit_info.framebuffer = worker.fb_;
+    // the framebuffer is only a hint and would tie reused secondaries to one swapchain image
+    inherit_info.framebuffer = reuse_secondaries_ ? VK_NULL_HANDLE : worker.fb_;
 
     VkCommandBufferBeginInfo begin_info = {};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -664,15 +1642,76 @@ void Hologram::draw_objects(Worker &worker) {
 
     meshes_->cmd_bind_buffers(cmd);
 
+    if (use_compute_) {
+        vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &data.desc_set, 0, nullptr);
+        vk::CmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(camera_.view_projection),
+                             glm::value_ptr(camera_.view_projection));
+    }
+
+    if (cull_objects_) {
+        draw_visible_objects(worker, data, cmd);
+        vk::EndCommandBuffer(cmd);
+        return;
+    }
+
+    // with sorting, the workers draw consecutive ranges of the back-to-front order and are executed in order
     for (int i = worker.object_begin_; i < worker.object_end_; i++) {
-        auto &obj = sim_.objects()[i];
+        auto &obj = sim_.objects()[sort_objects_ ? sort_entries_[0][i].index : i];
 
-        draw_object(obj, data, cmd);
+        // instances are indexed by firstInstance
+        if (use_compute_)
+            meshes_->cmd_draw(cmd, obj.mesh, i);
+        else
+            draw_object(obj, data, cmd);
     }
 
     vk::EndCommandBuffer(cmd);
 }
 
+void Hologram::draw_visible_objects(Worker &worker, FrameData &data, VkCommandBuffer cmd) {
+    auto &grid = cull_grids_[worker.index_];
+
+    for (int cell = 0; cell < CullGrid::cell_count; cell++) {
+        if (grid.cell_begin[cell] == grid.cell_begin[cell + 1]) continue;
+
+        const glm::vec3 center = (grid.cell_min[cell] + grid.cell_max[cell]) * 0.5f;
+        const glm::vec3 half_extent = (grid.cell_max[cell] - grid.cell_min[cell]) * 0.5f;
+
+        // objects of cells entirely inside the frustum need no tests of their own
+        bool outside = false, inside = true;
+        for (const auto &plane : cull_planes_) {
+            const float dist = glm::dot(glm::vec3(plane), center) + plane.w;
+            const float radius = glm::dot(glm::abs(glm::vec3(plane)), half_extent);
+            if (dist < -radius) {
+                outside = true;
+                break;
+            }
+            if (dist < radius) inside = false;
+        }
+        if (outside) continue;
+
+        for (uint32_t j = grid.cell_begin[cell]; j < grid.cell_begin[cell + 1]; j++) {
+            const int i = grid.objects[j];
+            const auto &obj = sim_.objects()[i];
+
+            if (!inside) {
+                const glm::vec3 pos = glm::mix(obj.tick_pos[0], obj.tick_pos[1], sim_frame_pred_);
+                const float radius = bounding_radius(obj);
+
+                grid.tested++;
+                if (std::any_of(cull_planes_.begin(), cull_planes_.end(), [&](const glm::vec4 &plane) {
+                        return glm::dot(glm::vec3(plane), pos) + plane.w < -radius;
+                    }))
+                    continue;
+            }
+
+            sim_.interpolate(sim_frame_pred_, i, i + 1);
+            draw_object(obj, data, cmd);
+            grid.visible++;
+        }
+    }
+}
+
 void Hologram::on_key(Key key) {
     switch (key) {
         case KEY_SHUTDOWN:
@@ -701,24 +1740,51 @@ void Hologram::on_key(Key key) {
 void Hologram::on_tick() {
     if (sim_paused_) return;
 
+    // the compute shader catches up on the next frame
+    if (use_compute_) {
+        compute_ticks_++;
+        return;
+    }
+
     for (auto &worker : workers_) worker->update_simulation();
 }
 
+void Hologram::on_frame_begin() {
+    if (!settings_.low_latency || frame_data_.empty()) return;
+
+    // wait for the frame data before input is sampled and the simulation steps, rather than after
+    auto &data = frame_data_[frame_data_index_];
+    vk::assert_success(vk::WaitForFences(dev_, 1, &data.fence, true, UINT64_MAX));
+}
+
 void Hologram::on_frame(float frame_pred) {
     auto &data = frame_data_[frame_data_index_];
 
     // wait for the last submission since we reuse frame data
     vk::assert_success(vk::WaitForFences(dev_, 1, &data.fence, true, UINT64_MAX));
+    shell_->context().deletion_queue->collect();
     vk::assert_success(vk::ResetFences(dev_, 1, &data.fence));
 
+    reset_command_buffers(data);
+    read_gpu_time(data);
+    if (dynamic_res_) update_render_scale();
+
     const Shell::BackBuffer &back = shell_->context().acquired_back_buffer;
 
-    // ignore frame_pred
+    // render between the last two ticks; while paused there is nothing to blend towards
+    sim_frame_pred_ = sim_paused_ ? 1.0f : std::min(frame_pred, 1.0f);
+    if (sort_objects_) sort_objects();
     for (auto &worker : workers_) worker->draw_objects(framebuffers_[back.image_index]);
 
     VkResult res = vk::BeginCommandBuffer(data.primary_cmd, &primary_cmd_begin_info_);
 
-    if (!use_push_constants_) {
+    if (gpu_timestamps_) {
+        vk::CmdResetQueryPool(data.primary_cmd, timestamp_pool_, 2 * frame_data_index_, 2);
+        vk::CmdWriteTimestamp(data.primary_cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_pool_, 2 * frame_data_index_);
+    }
+
+    // with use_compute_, compute_semaphore makes the instances visible instead
+    if (!use_push_constants_ && !use_compute_) {
         VkBufferMemoryBarrier buf_barrier = {};
         buf_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
         buf_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
@@ -733,34 +1799,265 @@ void Hologram::on_frame(float frame_pred) {
     }
 
     render_pass_begin_info_.framebuffer = framebuffers_[back.image_index];
-    render_pass_begin_info_.renderArea.extent = extent_;
+    render_pass_begin_info_.renderArea.extent = scissor_.extent;
     vk::CmdBeginRenderPass(data.primary_cmd, &render_pass_begin_info_, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
     // record render pass commands
     for (auto &worker : workers_) worker->wait_idle();
     vk::CmdExecuteCommands(data.primary_cmd, static_cast<uint32_t>(data.worker_cmds.size()), data.worker_cmds.data());
+    data.worker_cmds_valid = reuse_secondaries_;
+
+    if (use_oit_) record_composite(data.primary_cmd, back.image_index);
 
     vk::CmdEndRenderPass(data.primary_cmd);
+
+    // the blit scales with the swapchain rather than with render_scale_, so it is left out of the GPU time
+    if (gpu_timestamps_) {
+        vk::CmdWriteTimestamp(data.primary_cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_pool_, 2 * frame_data_index_ + 1);
+        data.timestamps_valid = true;
+    }
+
+    if (dynamic_res_) record_scene_blit(data.primary_cmd, back.image_index);
+
     vk::EndCommandBuffer(data.primary_cmd);
 
-    // wait for the image to be owned and signal for render completion
-    primary_cmd_submit_info_.pWaitSemaphores = &back.acquire_semaphore;
+    if (use_compute_) submit_compute(data);
+
+    // wait for the image to be owned (and the instances to be written) and signal for render completion
+    const VkSemaphore wait_semaphores[2] = {back.acquire_semaphore, data.compute_semaphore};
+    primary_cmd_submit_info_.pWaitSemaphores = wait_semaphores;
     primary_cmd_submit_info_.pCommandBuffers = &data.primary_cmd;
     primary_cmd_submit_info_.pSignalSemaphores = &back.render_semaphore;
 
     res = vk::QueueSubmit(queue_, 1, &primary_cmd_submit_info_, data.fence);
+    shell_->context().deletion_queue->submit(data.fence);
 
     frame_data_index_ = (frame_data_index_ + 1) % frame_data_.size();
 
+    log_frame_time();
+
     (void)res;
 }
 
+void Hologram::record_composite(VkCommandBuffer cmd, uint32_t image_index) {
+    vk::CmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+
+    vk::CmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, oit_pipeline_);
+    vk::CmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, oit_pipeline_layout_, 0, 1, &oit_desc_sets_[image_index], 0,
+                              nullptr);
+    vk::CmdSetViewport(cmd, 0, 1, &viewport_);
+    vk::CmdSetScissor(cmd, 0, 1, &scissor_);
+    vk::CmdDraw(cmd, 3, 1, 0, 0);
+}
+
+void Hologram::read_gpu_time(FrameData &data) {
+    if (!data.timestamps_valid) return;
+
+    // the fence has signaled
+    uint64_t timestamps[2];
+    vk::assert_success(vk::GetQueryPoolResults(dev_, timestamp_pool_, 2 * frame_data_index_, 2, sizeof(timestamps), timestamps,
+                                               sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT));
+    data.timestamps_valid = false;
+
+    gpu_time_ms_ = static_cast<float>(timestamps[1] - timestamps[0]) * physical_dev_props_.limits.timestampPeriod / 1e6f;
+    gpu_time_sum_ms_ += gpu_time_ms_;
+    gpu_time_samples_++;
+}
+
+void Hologram::update_render_scale() {
+    // frames already in flight were recorded at the old scale
+    if (render_scale_hold_ > 0) {
+        render_scale_hold_--;
+        return;
+    }
+
+    // the cost is mostly per pixel, so drop at once by the square root of the overshoot but only creep back up
+    float scale = render_scale_;
+    if (gpu_time_ms_ > gpu_budget_ms_)
+        scale *= std::sqrt(gpu_budget_ms_ / gpu_time_ms_);
+    else if (gpu_time_ms_ < 0.8f * gpu_budget_ms_)
+        scale += 0.02f;
+    scale = glm::clamp(scale, 0.5f, 1.0f);
+
+    if (std::abs(scale - render_scale_) < 0.01f) return;
+
+    render_scale_ = scale;
+    render_scale_hold_ = static_cast<int>(frame_data_.size());
+
+    prepare_viewport(extent_);
+    invalidate_secondaries();
+}
+
+void Hologram::record_scene_blit(VkCommandBuffer cmd, uint32_t image_index) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = images_[image_index];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    // chained to the wait for the acquire semaphore
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                           &barrier);
+
+    VkImageBlit region = {};
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.layerCount = 1;
+    region.srcOffsets[1].x = static_cast<int32_t>(scissor_.extent.width);
+    region.srcOffsets[1].y = static_cast<int32_t>(scissor_.extent.height);
+    region.srcOffsets[1].z = 1;
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffsets[1].x = static_cast<int32_t>(extent_.width);
+    region.dstOffsets[1].y = static_cast<int32_t>(extent_.height);
+    region.dstOffsets[1].z = 1;
+
+    vk::CmdBlitImage(cmd, scene_targets_[image_index].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, images_[image_index],
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vk::CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                           &barrier);
+}
+
+void Hologram::log_frame_time() {
+    // averaged over enough frames to compare the modes
+    const int frame_time_frames = 300;
+
+    auto now = std::chrono::steady_clock::now();
+    if (frame_time_count_++ == 0) {
+        frame_time_begin_ = now;
+        gpu_time_sum_ms_ = 0.0;
+        gpu_time_samples_ = 0;
+        for (auto &grid : cull_grids_) grid.tested = grid.visible = 0;
+        return;
+    }
+
+    if (frame_time_count_ <= frame_time_frames) return;
+
+    const double ms = std::chrono::duration<double, std::milli>(now - frame_time_begin_).count() / frame_time_frames;
+    // the modes in effect after attach_shell has dropped the incompatible ones
+    std::stringstream ss;
+    if (use_compute_)
+        ss << "compute";
+    else if (use_push_constants_)
+        ss << "push constants";
+    else
+        ss << "uniform buffers";
+
+    if (use_oit_)
+        ss << ", OIT";
+    else if (sort_objects_)
+        ss << ", sorted";
+    else if (!use_compute_)
+        ss << ", unsorted";
+
+    if (cull_objects_) ss << ", culled";
+    if (reuse_secondaries_) ss << ", reused secondaries";
+    if (!multithread_) ss << ", single thread";
+    if (dynamic_res_) ss << ", dynamic resolution";
+
+    ss << ": " << ms << " ms per frame";
+
+    // the render pass alone, which is what the paths differ in
+    if (gpu_time_samples_) {
+        const double gpu_ms = gpu_time_sum_ms_ / gpu_time_samples_;
+        ss << ", " << gpu_ms << " ms GPU time";
+
+        // the targets are cleared, blended into at least once and read back by the composite, 10 bytes per pixel each
+        if (use_oit_) {
+            const double oit_bytes = 3.0 * scissor_.extent.width * scissor_.extent.height * 10;
+            ss << " with at least " << oit_bytes / (1024 * 1024) << " MB of OIT target traffic ("
+               << oit_bytes / (gpu_ms * 1e6) << " GB/s)";
+        }
+
+        gpu_time_sum_ms_ = 0.0;
+        gpu_time_samples_ = 0;
+    }
+
+    if (cull_objects_) {
+        uint64_t tested = 0, visible = 0;
+        for (auto &grid : cull_grids_) {
+            tested += grid.tested;
+            visible += grid.visible;
+            grid.tested = grid.visible = 0;
+        }
+
+        ss << ", " << tested / frame_time_frames << " of " << sim_.objects().size() << " objects tested and "
+           << visible / frame_time_frames << " visible per frame";
+    }
+
+    // retained by swapchain recreation
+    const DeletionQueue::Stats &deletion_stats = shell_->context().deletion_queue->stats();
+    if (deletion_stats.peak_retained_bytes)
+        ss << ", " << deletion_stats.retained_handles << " handles and " << deletion_stats.retained_bytes / 1024
+           << " KB awaiting deletion (peak " << deletion_stats.peak_retained_bytes / 1024 << " KB)";
+
+    if (dynamic_res_)
+        ss << ", " << scissor_.extent.width << "x" << scissor_.extent.height << " for a " << gpu_budget_ms_
+           << " ms GPU budget";
+
+    shell_->log(Shell::LOG_INFO, ss.str().c_str());
+
+    frame_time_begin_ = now;
+    frame_time_count_ = 1;
+}
+
+void Hologram::submit_compute(FrameData &data) {
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vk::BeginCommandBuffer(data.compute_cmd, &begin_info);
+
+    // the objects from the last dispatch
+    VkMemoryBarrier mem_barrier = {};
+    mem_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    mem_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    mem_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vk::CmdPipelineBarrier(data.compute_cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                           &mem_barrier, 0, nullptr, 0, nullptr);
+
+    ComputeParamBlock params;
+    params.tick_interval = 1.0f / settings_.ticks_per_second;
+    params.tick_count = compute_ticks_;
+    params.object_count = static_cast<uint32_t>(sim_.objects().size());
+    params.fade = sim_fade_;
+
+    // a frame may see zero ticks, but the instances of this frame data must be written regardless
+    compute_ticks_ = 0;
+
+    vk::CmdBindPipeline(data.compute_cmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_);
+    vk::CmdBindDescriptorSets(data.compute_cmd, VK_PIPELINE_BIND_POINT_COMPUTE, compute_pipeline_layout_, 0, 1,
+                              &data.compute_desc_set, 0, nullptr);
+    vk::CmdPushConstants(data.compute_cmd, compute_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vk::CmdDispatch(data.compute_cmd, (params.object_count + 63) / 64, 1, 1);
+
+    vk::EndCommandBuffer(data.compute_cmd);
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &data.compute_cmd;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &data.compute_semaphore;
+    vk::assert_success(vk::QueueSubmit(compute_queue_, 1, &submit_info, VK_NULL_HANDLE));
+}
+
 Hologram::Worker::Worker(Hologram &hologram, int index, int object_begin, int object_end)
     : hologram_(hologram),
       index_(index),
       object_begin_(object_begin),
       object_end_(object_end),
       tick_interval_(1.0f / hologram.settings_.ticks_per_second),
+      sort_step_(SORT_KEYS),
       state_(INIT) {}
 
 void Hologram::Worker::start() {
@@ -794,6 +2091,26 @@ void Hologram::Worker::update_simulation() {
     state_cv_.notify_one();
 }
 
+void Hologram::Worker::sort_objects(SortStep step) {
+    // wait for step_objects or the previous step first
+    wait_idle();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool started = (state_ != INIT);
+
+        sort_step_ = step;
+        state_ = SORT;
+
+        // sort directly
+        if (!started) {
+            hologram_.sort_objects(*this);
+            state_ = INIT;
+        }
+    }
+    state_cv_.notify_one();
+}
+
 void Hologram::Worker::draw_objects(VkFramebuffer fb) {
     // wait for step_objects first
     wait_idle();
@@ -828,9 +2145,11 @@ void Hologram::Worker::update_loop() {
         state_cv_.wait(lock, [this] { return (state_ != IDLE); });
         if (state_ == INIT) break;
 
-        assert(state_ == STEP || state_ == DRAW);
+        assert(state_ == STEP || state_ == SORT || state_ == DRAW);
         if (state_ == STEP)
             hologram_.update_simulation(*this);
+        else if (state_ == SORT)
+            hologram_.sort_objects(*this);
         else
             hologram_.draw_objects(*this);
 
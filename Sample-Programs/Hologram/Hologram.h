@@ -17,6 +17,8 @@
 #ifndef HOLOGRAM_H
 #define HOLOGRAM_H
 
+#include <array>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -41,14 +43,24 @@ class Hologram : public Game {
     void detach_shell();
 
     void attach_swapchain();
+    bool retire_swapchain();
     void detach_swapchain();
 
     void on_key(Key key);
     void on_tick();
 
+    void on_frame_begin();
     void on_frame(float frame_pred);
 
    private:
+    // phases of the back-to-front radix sort, each run by all workers on their own ranges
+    enum SortStep {
+        SORT_KEYS,
+        SORT_SCATTER_LOW,
+        SORT_COUNT_HIGH,
+        SORT_SCATTER_HIGH,
+    };
+
     class Worker {
        public:
         Worker(Hologram &hologram, int index, int object_begin, int object_end);
@@ -56,6 +68,7 @@ class Hologram : public Game {
         void start();
         void stop();
         void update_simulation();
+        void sort_objects(SortStep step);
         void draw_objects(VkFramebuffer fb);
         void wait_idle();
 
@@ -68,12 +81,14 @@ class Hologram : public Game {
         const float tick_interval_;
 
         VkFramebuffer fb_;
+        SortStep sort_step_;
 
        private:
         enum State {
             INIT,
             IDLE,
             STEP,
+            SORT,
             DRAW,
         };
 
@@ -89,21 +104,45 @@ class Hologram : public Game {
 
     struct Camera {
         glm::vec3 eye_pos;
+        float z_near;
+        float z_far;
         glm::mat4 view_projection;
 
-        Camera(float eye) : eye_pos(eye) {}
+        Camera(float eye) : eye_pos(eye), z_near(0.1f), z_far(100.0f) {}
+    };
+
+    struct SortEntry {
+        uint32_t key;
+        uint32_t index;
     };
 
     struct FrameData {
         // signaled when this struct is ready for reuse
         VkFence fence;
 
+        // one transient pool per worker plus one for the primary, reset as a whole once fence signals
+        VkCommandPool primary_cmd_pool;
+        std::vector<VkCommandPool> worker_cmd_pools;
+
         VkCommandBuffer primary_cmd;
         std::vector<VkCommandBuffer> worker_cmds;
 
+        // with reuse_secondaries_, worker_cmds are kept across frames until invalidate_secondaries
+        bool worker_cmds_valid;
+
+        // with gpu_timestamps_, whether this frame's pair of timestamps has been written and not yet read
+        bool timestamps_valid;
+
         VkBuffer buf;
         uint8_t *base;
         VkDescriptorSet desc_set;
+
+        // with use_compute_, compute_cmd writes instance_buf in place of buf
+        VkCommandPool compute_cmd_pool;
+        VkCommandBuffer compute_cmd;
+        VkSemaphore compute_semaphore;
+        VkBuffer instance_buf;
+        VkDescriptorSet compute_desc_set;
     };
 
     // called by the constructor
@@ -111,6 +150,12 @@ class Hologram : public Game {
 
     bool multithread_;
     bool use_push_constants_;
+    bool use_compute_;
+    bool reuse_secondaries_;
+    bool sort_objects_;
+    bool use_oit_;
+    bool cull_objects_;
+    bool dynamic_res_;
 
     // called mostly by on_key
     void update_camera();
@@ -118,29 +163,72 @@ class Hologram : public Game {
     bool sim_paused_;
     bool sim_fade_;
     Simulation sim_;
+    // how far the frame being drawn is past the latest tick, in ticks
+    float sim_frame_pred_;
     Camera camera_;
 
     std::vector<std::unique_ptr<Worker>> workers_;
 
+    // called by on_frame with sort_objects_, leaves the draw order in sort_entries_[0]
+    void sort_objects();
+    void prefix_sort_counts();
+
+    // one digit histogram per worker, turned into scatter offsets by prefix_sort_counts
+    std::vector<SortEntry> sort_entries_[2];
+    std::vector<std::array<uint32_t, 256>> sort_counts_;
+
+    // with cull_objects_, every worker buckets its own objects into a coarse grid over the simulation cube each tick
+    struct CullGrid {
+        static const int dim = 4;
+        static const int cell_count = dim * dim * dim;
+
+        // the objects of cell c are objects[cell_begin[c]] up to objects[cell_begin[c + 1]]
+        std::array<uint32_t, cell_count + 1> cell_begin;
+        std::array<glm::vec3, cell_count> cell_min;
+        std::array<glm::vec3, cell_count> cell_max;
+        std::vector<uint32_t> objects;
+        std::vector<uint8_t> object_cells;
+
+        // per-object sphere tests and draws, summed up by log_frame_time
+        uint64_t tested;
+        uint64_t visible;
+    };
+
+    std::vector<CullGrid> cull_grids_;
+    // the normalized frustum planes of camera_.view_projection
+    std::array<glm::vec4, 6> cull_planes_;
+
     // called by attach_shell
     void create_render_pass();
+    void create_oit_render_pass();
     void create_shader_modules();
     void create_descriptor_set_layout();
     void create_pipeline_layout();
     void create_pipeline();
+    void create_compute_pipeline();
+    void create_object_buffer();
+    void create_oit_pipeline();
 
     void create_frame_data(int count);
     void destroy_frame_data();
     void create_fences();
     void create_command_buffers();
+    void reset_command_buffers(FrameData &data);
     void create_buffers();
     void create_buffer_memory();
+    void create_instance_buffers();
     void create_descriptor_sets();
 
+    uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags flags) const;
+
     VkPhysicalDevice physical_dev_;
     VkDevice dev_;
     VkQueue queue_;
     uint32_t queue_family_;
+    VkQueue compute_queue_;
+    uint32_t compute_queue_family_;
+    VkQueue transfer_queue_;
+    uint32_t transfer_queue_family_;
     VkFormat format_;
     VkDeviceSize aligned_object_data_size;
 
@@ -156,23 +244,53 @@ class Hologram : public Game {
     VkPipelineLayout pipeline_layout_;
     VkPipeline pipeline_;
 
-    VkCommandPool primary_cmd_pool_;
-    std::vector<VkCommandPool> worker_cmd_pools_;
+    // with use_oit_, objects accumulate in subpass 0 and this composites them in subpass 1
+    VkShaderModule composite_vs_;
+    VkShaderModule composite_fs_;
+    VkDescriptorSetLayout oit_desc_set_layout_;
+    VkPipelineLayout oit_pipeline_layout_;
+    VkPipeline oit_pipeline_;
+
+    VkShaderModule cs_;
+    VkDescriptorSetLayout compute_desc_set_layout_;
+    VkPipelineLayout compute_pipeline_layout_;
+    VkPipeline compute_pipeline_;
+
+    // per-object simulation state, only touched by the compute queue after upload
+    VkBuffer object_buf_;
+    VkDeviceMemory object_mem_;
+    int compute_ticks_;
+
     VkDescriptorPool desc_pool_;
     VkDeviceMemory frame_data_mem_;
+    VkDeviceMemory instance_mem_;
     std::vector<FrameData> frame_data_;
     int frame_data_index_;
 
-    VkClearValue render_pass_clear_value_;
+    // swapchain image, accumulation and revealage
+    std::array<VkClearValue, 3> render_pass_clear_values_;
     VkRenderPassBeginInfo render_pass_begin_info_;
 
     VkCommandBufferBeginInfo primary_cmd_begin_info_;
-    VkPipelineStageFlags primary_cmd_submit_wait_stages_;
+    VkPipelineStageFlags primary_cmd_submit_wait_stages_[2];
     VkSubmitInfo primary_cmd_submit_info_;
 
+    struct RenderTarget {
+        VkImage image;
+        VkDeviceMemory mem;
+        VkDeviceSize mem_size;
+        VkImageView view;
+    };
+
     // called by attach_swapchain
     void prepare_viewport(const VkExtent2D &extent);
     void prepare_framebuffers(VkSwapchainKHR swapchain);
+    void prepare_oit_targets();
+    void prepare_scene_targets();
+    void create_render_target(VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags mem_flags, RenderTarget &target);
+
+    // must be called whenever the objects, the pipeline or the viewport change
+    void invalidate_secondaries();
 
     VkExtent2D extent_;
     VkViewport viewport_;
@@ -182,10 +300,44 @@ class Hologram : public Game {
     std::vector<VkImageView> image_views_;
     std::vector<VkFramebuffer> framebuffers_;
 
+    // one set per swapchain image
+    std::vector<RenderTarget> oit_accum_;
+    std::vector<RenderTarget> oit_revealage_;
+    VkDescriptorPool oit_desc_pool_;
+    std::vector<VkDescriptorSet> oit_desc_sets_;
+
+    // with dynamic_res_, the scene is drawn into the top-left render_scale_ of these and blitted to the swapchain images
+    std::vector<RenderTarget> scene_targets_;
+    float gpu_budget_ms_;
+    float gpu_time_ms_;
+    float render_scale_;
+    int render_scale_hold_;
+
+    // with gpu_timestamps_, a begin and an end timestamp around the render pass per frame data
+    bool gpu_timestamps_;
+    VkQueryPool timestamp_pool_;
+
+    // called by on_frame
+    void submit_compute(FrameData &data);
+    void record_composite(VkCommandBuffer cmd, uint32_t image_index);
+    void read_gpu_time(FrameData &data);
+    void update_render_scale();
+    void record_scene_blit(VkCommandBuffer cmd, uint32_t image_index);
+    void log_frame_time();
+
+    std::chrono::steady_clock::time_point frame_time_begin_;
+    int frame_time_count_;
+    double gpu_time_sum_ms_;
+    int gpu_time_samples_;
+
     // called by workers
     void update_simulation(const Worker &worker);
+    void update_cull_grid(const Worker &worker);
+    void sort_objects(Worker &worker);
+    void update_object(const Simulation::Object &obj, FrameData &data) const;
     void draw_object(const Simulation::Object &obj, FrameData &data, VkCommandBuffer cmd) const;
     void draw_objects(Worker &worker);
+    void draw_visible_objects(Worker &worker, FrameData &data, VkCommandBuffer cmd);
 };
 
 #endif  // HOLOGRAM_H
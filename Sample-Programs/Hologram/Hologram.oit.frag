@@ -0,0 +1,21 @@
+#version 310 es
+
+precision highp float;
+
+layout(location = 0) in vec3 color;
+layout(location = 1) in float alpha;
+
+// weighted blended order-independent transparency, McGuire and Bavoil 2013
+layout(location = 0) out vec4 accum;
+layout(location = 1) out float revealage;
+
+void main()
+{
+	// view depth, as gl_FragCoord.w is 1 / clip w
+	float depth = 1.0 / gl_FragCoord.w;
+	float weight = alpha * clamp(10.0 / (1e-5 + pow(depth / 5.0, 2.0) + pow(depth / 200.0, 6.0)), 1e-2, 3e3);
+
+	// summed, and multiplied into (1 - alpha) by the blend state
+	accum = vec4(color * alpha, alpha) * weight;
+	revealage = alpha;
+}
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <string>
 #include <vector>
 
@@ -28,6 +31,34 @@ Game *create_game(int argc, char **argv) {
     return create_game(args);
 }
 
+// --bench-path times Path::position on its own, without a window or a device
+bool bench_path(int argc, char **argv) {
+    std::vector<std::string> args(argv, argv + argc);
+    if (std::find(args.begin(), args.end(), "--bench-path") == args.end()) return false;
+
+    const int path_count = 4096;
+    const int tick_count = 2000;
+    // long ticks so that subpaths and curve segments turn over often
+    const float tick = 0.25f;
+
+    std::mt19937 rng(0);
+    std::vector<Path> paths;
+    paths.reserve(path_count);
+    for (int i = 0; i < path_count; i++) paths.emplace_back(Path(rng()));
+
+    glm::vec3 sum(0.0f);
+    auto begin = std::chrono::steady_clock::now();
+    for (int t = 0; t < tick_count; t++) {
+        for (auto &path : paths) sum += path.position(tick);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count() / (static_cast<double>(path_count) * tick_count);
+    std::cout << "Path::position: " << ns << " ns per call (checksum " << sum.x + sum.y + sum.z << ")" << std::endl;
+
+    return true;
+}
+
 }  // namespace
 
 #if defined(VK_USE_PLATFORM_XCB_KHR)
@@ -35,6 +66,8 @@ Game *create_game(int argc, char **argv) {
 #include "ShellXcb.h"
 
 int main(int argc, char **argv) {
+    if (bench_path(argc, argv)) return 0;
+
     Game *game = create_game(argc, argv);
     {
         ShellXcb shell(*game);
@@ -50,6 +83,8 @@ int main(int argc, char **argv) {
 #include "ShellWayland.h"
 
 int main(int argc, char **argv) {
+    if (bench_path(argc, argv)) return 0;
+
     Game *game = create_game(argc, argv);
     {
         ShellWayland shell(*game);
@@ -82,6 +117,8 @@ void android_main(android_app *app) {
 #include "ShellWin32.h"
 
 int main(int argc, char **argv) {
+    if (bench_path(argc, argv)) return 0;
+
     Game *game = create_game(argc, argv);
     {
         ShellWin32 shell(*game);
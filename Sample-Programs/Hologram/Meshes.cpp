@@ -438,9 +438,9 @@ void Meshes::cmd_bind_buffers(VkCommandBuffer cmd) const {
     vk::CmdBindIndexBuffer(cmd, ib_, 0, index_type_);
 }
 
-void Meshes::cmd_draw(VkCommandBuffer cmd, Type type) const {
+void Meshes::cmd_draw(VkCommandBuffer cmd, Type type, uint32_t first_instance) const {
     const auto &draw = draw_commands_[type];
-    vk::CmdDrawIndexed(cmd, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+    vk::CmdDrawIndexed(cmd, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, first_instance);
 }
 
 void Meshes::allocate_resources(VkDeviceSize vb_size, VkDeviceSize ib_size, const std::vector<VkMemoryPropertyFlags> &mem_flags) {
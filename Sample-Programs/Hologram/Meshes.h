@@ -37,7 +37,7 @@ class Meshes {
     };
 
     void cmd_bind_buffers(VkCommandBuffer cmd) const;
-    void cmd_draw(VkCommandBuffer cmd, Type type) const;
+    void cmd_draw(VkCommandBuffer cmd, Type type, uint32_t first_instance = 0) const;
 
    private:
     void allocate_resources(VkDeviceSize vb_size, VkDeviceSize ib_size, const std::vector<VkMemoryPropertyFlags> &mem_flags);
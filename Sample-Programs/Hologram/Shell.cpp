@@ -14,18 +14,33 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <array>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <set>
+#include "DeletionQueue.h"
 #include "Helpers.h"
 #include "Shell.h"
 #include "Game.h"
 
 Shell::Shell(Game &game)
-    : game_(game), settings_(game.settings()), ctx_(), game_tick_(1.0f / settings_.ticks_per_second), game_time_(game_tick_) {
+    : game_(game),
+      settings_(game.settings()),
+      ctx_(),
+      has_physical_dev_properties2_(false),
+      has_surface_maintenance1_(false),
+      present_id_(0),
+      present_id_base_(0),
+      acquire_count_(0),
+      game_tick_(1.0f / settings_.ticks_per_second),
+      game_time_(game_tick_),
+      profile_start_time_(0.0),
+      profile_present_count_(0),
+      profile_present_cpu_time_(0.0) {
     // require generic WSI extensions
     instance_extensions_.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
     device_extensions_.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
@@ -119,6 +134,28 @@ void Shell::assert_all_instance_extensions() const {
     }
 }
 
+void Shell::add_optional_instance_extensions() {
+    std::vector<VkExtensionProperties> exts;
+    vk::enumerate(nullptr, exts);
+
+    std::set<std::string> ext_names;
+    for (const auto &ext : exts) ext_names.insert(ext.extensionName);
+
+    // needed to query and enable the features used for present pacing
+    if (ext_names.count(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+        instance_extensions_.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        has_physical_dev_properties2_ = true;
+    }
+
+    // needed by VK_EXT_swapchain_maintenance1
+    if (has_physical_dev_properties2_ && ext_names.count(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) &&
+        ext_names.count(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME)) {
+        instance_extensions_.push_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+        instance_extensions_.push_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        has_surface_maintenance1_ = true;
+    }
+}
+
 bool Shell::has_all_device_extensions(VkPhysicalDevice phy) const {
     // enumerate device extensions
     std::vector<VkExtensionProperties> exts;
@@ -136,6 +173,8 @@ bool Shell::has_all_device_extensions(VkPhysicalDevice phy) const {
 }
 
 void Shell::init_instance() {
+    add_optional_instance_extensions();
+
     assert_all_instance_layers();
     assert_all_instance_extensions();
 
@@ -205,6 +244,7 @@ void Shell::init_physical_dev() {
             ctx_.physical_dev = phy;
             ctx_.game_queue_family = game_queue_family;
             ctx_.present_queue_family = present_queue_family;
+            init_async_queue_families(queues);
             break;
         }
     }
@@ -212,14 +252,55 @@ void Shell::init_physical_dev() {
     if (ctx_.physical_dev == VK_NULL_HANDLE) throw std::runtime_error("failed to find any capable Vulkan physical device");
 }
 
+void Shell::init_async_queue_families(const std::vector<VkQueueFamilyProperties> &queues) {
+    const VkFlags graphics_compute_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+
+    int compute_queue_family = -1, transfer_queue_family = -1;
+    for (uint32_t i = 0; i < queues.size(); i++) {
+        const VkFlags flags = queues[i].queueFlags;
+
+        // COMPUTE without GRAPHICS runs asynchronously to the game queue
+        if (compute_queue_family < 0 && (flags & graphics_compute_flags) == VK_QUEUE_COMPUTE_BIT) compute_queue_family = i;
+
+        // TRANSFER only is usually backed by a copy engine
+        if (transfer_queue_family < 0 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & graphics_compute_flags)) transfer_queue_family = i;
+    }
+
+    // GRAPHICS does not imply COMPUTE, but some GRAPHICS family must have both
+    if (compute_queue_family < 0) {
+        for (uint32_t i = 0; i < queues.size(); i++) {
+            if (queues[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+                compute_queue_family = i;
+                if (i == ctx_.game_queue_family) break;
+            }
+        }
+    }
+
+    // no family has COMPUTE at all, and the game has to fall back to the CPU
+    if (compute_queue_family < 0) {
+        ctx_.compute_queue_family = VK_QUEUE_FAMILY_IGNORED;
+        ctx_.transfer_queue_family = (transfer_queue_family >= 0) ? transfer_queue_family : ctx_.game_queue_family;
+        return;
+    }
+
+    ctx_.compute_queue_family = compute_queue_family;
+    ctx_.transfer_queue_family = (transfer_queue_family >= 0) ? transfer_queue_family : compute_queue_family;
+}
+
 void Shell::create_context() {
     create_dev();
     vk::init_dispatch_table_bottom(ctx_.instance, ctx_.dev);
 
     vk::GetDeviceQueue(ctx_.dev, ctx_.game_queue_family, 0, &ctx_.game_queue);
     vk::GetDeviceQueue(ctx_.dev, ctx_.present_queue_family, 0, &ctx_.present_queue);
+    if (ctx_.compute_queue_family != VK_QUEUE_FAMILY_IGNORED)
+        vk::GetDeviceQueue(ctx_.dev, ctx_.compute_queue_family, 0, &ctx_.compute_queue);
+    else
+        ctx_.compute_queue = VK_NULL_HANDLE;
+    vk::GetDeviceQueue(ctx_.dev, ctx_.transfer_queue_family, 0, &ctx_.transfer_queue);
 
     create_back_buffers();
+    ctx_.deletion_queue = new DeletionQueue(ctx_.dev);
 
     // initialize ctx_.{surface,format} before attach_shell
     create_swapchain();
@@ -231,15 +312,22 @@ void Shell::destroy_context() {
     if (ctx_.dev == VK_NULL_HANDLE) return;
 
     vk::DeviceWaitIdle(ctx_.dev);
+    wait_back_buffers();
 
     destroy_swapchain();
 
     game_.detach_shell();
 
+    ctx_.deletion_queue->flush();
+    delete ctx_.deletion_queue;
+    ctx_.deletion_queue = nullptr;
+
     destroy_back_buffers();
 
     ctx_.game_queue = VK_NULL_HANDLE;
     ctx_.present_queue = VK_NULL_HANDLE;
+    ctx_.compute_queue = VK_NULL_HANDLE;
+    ctx_.transfer_queue = VK_NULL_HANDLE;
 
     vk::DeviceWaitIdle(ctx_.dev);
     vk::DestroyDevice(ctx_.dev, nullptr);
@@ -251,26 +339,96 @@ void Shell::create_dev() {
     dev_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
     const std::vector<float> queue_priorities(settings_.queue_count, 0.0f);
-    std::array<VkDeviceQueueCreateInfo, 2> queue_info = {};
-    queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queue_info[0].queueFamilyIndex = ctx_.game_queue_family;
-    queue_info[0].queueCount = settings_.queue_count;
-    queue_info[0].pQueuePriorities = queue_priorities.data();
+    std::vector<VkDeviceQueueCreateInfo> queue_info;
+    queue_info.reserve(4);
+
+    VkDeviceQueueCreateInfo game_queue_info = {};
+    game_queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    game_queue_info.queueFamilyIndex = ctx_.game_queue_family;
+    game_queue_info.queueCount = settings_.queue_count;
+    game_queue_info.pQueuePriorities = queue_priorities.data();
+    queue_info.push_back(game_queue_info);
+
+    // one queue from each of the other families
+    const std::array<uint32_t, 3> other_queue_families = {
+        ctx_.present_queue_family, ctx_.compute_queue_family, ctx_.transfer_queue_family,
+    };
+    for (auto family : other_queue_families) {
+        if (family == VK_QUEUE_FAMILY_IGNORED) continue;
+
+        bool found = false;
+        for (const auto &info : queue_info) {
+            if (info.queueFamilyIndex == family) {
+                found = true;
+                break;
+            }
+        }
+        if (found) continue;
 
-    if (ctx_.game_queue_family != ctx_.present_queue_family) {
-        queue_info[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_info[1].queueFamilyIndex = ctx_.present_queue_family;
-        queue_info[1].queueCount = 1;
-        queue_info[1].pQueuePriorities = queue_priorities.data();
+        VkDeviceQueueCreateInfo info = game_queue_info;
+        info.queueFamilyIndex = family;
+        info.queueCount = 1;
+        queue_info.push_back(info);
+    }
 
-        dev_info.queueCreateInfoCount = 2;
-    } else {
-        dev_info.queueCreateInfoCount = 1;
+    dev_info.queueCreateInfoCount = static_cast<uint32_t>(queue_info.size());
+
+    // pick the cheapest way to know when a back buffer can be reused
+    std::vector<const char *> exts(device_extensions_);
+    ctx_.present_pacing = PRESENT_PACING_SUBMIT;
+
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT maintenance1_features = {};
+    maintenance1_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    if (has_physical_dev_properties2_ && !settings_.no_present) {
+        std::vector<VkExtensionProperties> dev_exts;
+        vk::enumerate(ctx_.physical_dev, nullptr, dev_exts);
+
+        std::set<std::string> ext_names;
+        for (const auto &ext : dev_exts) ext_names.insert(ext.extensionName);
+
+        const bool has_maintenance1 =
+            has_surface_maintenance1_ && ext_names.count(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+        const bool has_present_wait =
+            ext_names.count(VK_KHR_PRESENT_ID_EXTENSION_NAME) && ext_names.count(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        if (has_maintenance1) {
+            maintenance1_features.pNext = features.pNext;
+            features.pNext = &maintenance1_features;
+        }
+        if (has_present_wait) {
+            present_id_features.pNext = features.pNext;
+            present_wait_features.pNext = &present_id_features;
+            features.pNext = &present_wait_features;
+        }
+        vk::GetPhysicalDeviceFeatures2KHR(ctx_.physical_dev, &features);
+
+        if (maintenance1_features.swapchainMaintenance1) {
+            exts.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+
+            maintenance1_features.pNext = nullptr;
+            dev_info.pNext = &maintenance1_features;
+            ctx_.present_pacing = PRESENT_PACING_FENCE;
+        } else if (present_id_features.presentId && present_wait_features.presentWait) {
+            exts.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            exts.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+            present_id_features.pNext = nullptr;
+            present_wait_features.pNext = &present_id_features;
+            dev_info.pNext = &present_wait_features;
+            ctx_.present_pacing = PRESENT_PACING_WAIT;
+        }
     }
 
     dev_info.pQueueCreateInfos = queue_info.data();
-    dev_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions_.size());
-    dev_info.ppEnabledExtensionNames = device_extensions_.data();
+    dev_info.enabledExtensionCount = static_cast<uint32_t>(exts.size());
+    dev_info.ppEnabledExtensionNames = exts.data();
 
     // disable all features
     VkPhysicalDeviceFeatures features = {};
@@ -290,8 +448,9 @@ void Shell::create_back_buffers() {
     // BackBuffer is used to track which swapchain image and its associated
     // sync primitives are busy.  Having more BackBuffer's than swapchain
     // images may allows us to replace CPU wait on present_fence by GPU wait
-    // on acquire_semaphore.
-    const int count = settings_.back_buffer_count + 1;
+    // on acquire_semaphore.  There must also be enough of them to not
+    // throttle the frames the game keeps in flight.
+    const int count = std::max(settings_.back_buffer_count, settings_.frames_in_flight) + 1;
     for (int i = 0; i < count; i++) {
         BackBuffer buf = {};
         vk::assert_success(vk::CreateSemaphore(ctx_.dev, &sem_info, nullptr, &buf.acquire_semaphore));
@@ -337,6 +496,13 @@ void Shell::destroy_swapchain() {
     if (ctx_.swapchain != VK_NULL_HANDLE) {
         game_.detach_swapchain();
 
+        // the device is idle
+        ctx_.deletion_queue->flush();
+        while (!retired_swapchains_.empty()) {
+            destroy_retired_swapchain(retired_swapchains_.front());
+            retired_swapchains_.pop();
+        }
+
         vk::DestroySwapchainKHR(ctx_.dev, ctx_.swapchain, nullptr);
         ctx_.swapchain = VK_NULL_HANDLE;
     }
@@ -402,6 +568,10 @@ void Shell::resize_swapchain(uint32_t width_hint, uint32_t height_hint) {
     swapchain_info.imageExtent = extent;
     swapchain_info.imageArrayLayers = 1;
     swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (settings_.swapchain_transfer_dst) {
+        assert(caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        swapchain_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
 
     std::vector<uint32_t> queue_families(1, ctx_.game_queue_family);
     if (ctx_.game_queue_family != ctx_.present_queue_family) {
@@ -424,12 +594,23 @@ void Shell::resize_swapchain(uint32_t width_hint, uint32_t height_hint) {
     vk::assert_success(vk::CreateSwapchainKHR(ctx_.dev, &swapchain_info, nullptr, &ctx_.swapchain));
     ctx_.extent = extent;
 
-    // destroy the old swapchain
+    // retire the old swapchain rather than draining the device; the game keeps rendering to the new one meanwhile
     if (swapchain_info.oldSwapchain != VK_NULL_HANDLE) {
-        vk::DeviceWaitIdle(ctx_.dev);
-
-        game_.detach_swapchain();
-        vk::DestroySwapchainKHR(ctx_.dev, swapchain_info.oldSwapchain, nullptr);
+        RetiredSwapchain retired = {};
+        retired.swapchain = swapchain_info.oldSwapchain;
+        retired.present_id = (present_id_ > present_id_base_) ? present_id_ : 0;
+        // the back buffers are reused in order, and one may be acquired
+        retired.release_acquire = acquire_count_ + ctx_.back_buffers.size() + 1;
+        retired_swapchains_.push(retired);
+
+        // presents to the old swapchain can no longer be waited for through the new one
+        present_id_base_ = present_id_;
+
+        // games not deferring destruction of their swapchain resources get them detached on an idle device
+        if (!game_.retire_swapchain()) {
+            vk::DeviceWaitIdle(ctx_.dev);
+            game_.detach_swapchain();
+        }
     }
 
     game_.attach_swapchain();
@@ -444,6 +625,66 @@ void Shell::add_game_time(float time) {
         game_.on_tick();
         game_time_ -= game_tick_;
     }
+
+    // drop what could not be caught up on rather than spiking again next frame
+    if (game_time_ >= game_tick_) game_time_ = std::fmod(game_time_, game_tick_);
+}
+
+void Shell::begin_profile(double time) {
+    profile_start_time_ = time;
+    profile_present_count_ = 0;
+    profile_present_cpu_time_ = 0.0;
+}
+
+void Shell::profile_present(double input_time, double present_time) {
+    profile_present_cpu_time_ += present_time - input_time;
+    profile_present_count_++;
+
+    const double elapsed = present_time - profile_start_time_;
+    if (elapsed < 5.0) return;
+
+    const double fps = profile_present_count_ / elapsed;
+    const double cpu_time = profile_present_cpu_time_ / profile_present_count_;
+    std::stringstream ss;
+    ss << profile_present_count_ << " presents in " << elapsed << " seconds "
+       << "(FPS: " << fps << ", CPU time until vkQueuePresentKHR returns: " << cpu_time * 1000.0 << " ms)";
+    log(LOG_INFO, ss.str().c_str());
+
+    begin_profile(present_time);
+}
+
+void Shell::wait_back_buffer(const BackBuffer &buf) const {
+    if (ctx_.present_pacing == PRESENT_PACING_WAIT) {
+        // never presented
+        if (!buf.present_id) return;
+
+        // present_swapchain may be retired by now, but is not destroyed before every back buffer is waited for again
+        VkResult res = vk::WaitForPresentKHR(ctx_.dev, buf.present_swapchain, buf.present_id, UINT64_MAX);
+        // the swapchain will be recreated by whoever sees VK_ERROR_OUT_OF_DATE_KHR next
+        if (res != VK_ERROR_OUT_OF_DATE_KHR && res != VK_SUBOPTIMAL_KHR) vk::assert_success(res);
+    } else {
+        vk::assert_success(vk::WaitForFences(ctx_.dev, 1, &buf.present_fence, true, UINT64_MAX));
+    }
+}
+
+void Shell::destroy_retired_swapchain(const RetiredSwapchain &retired) const {
+    if (retired.present_id) {
+        VkResult res = vk::WaitForPresentKHR(ctx_.dev, retired.swapchain, retired.present_id, UINT64_MAX);
+        if (res != VK_ERROR_OUT_OF_DATE_KHR && res != VK_SUBOPTIMAL_KHR) vk::assert_success(res);
+    }
+
+    vk::DestroySwapchainKHR(ctx_.dev, retired.swapchain, nullptr);
+}
+
+void Shell::wait_back_buffers() const {
+    // only fences signaled by presents are not covered by vkDeviceWaitIdle
+    if (ctx_.present_pacing != PRESENT_PACING_FENCE) return;
+
+    auto bufs = ctx_.back_buffers;
+    while (!bufs.empty()) {
+        wait_back_buffer(bufs.front());
+        bufs.pop();
+    }
 }
 
 void Shell::acquire_back_buffer() {
@@ -453,9 +694,14 @@ void Shell::acquire_back_buffer() {
     auto &buf = ctx_.back_buffers.front();
 
     // wait until acquire and render semaphores are waited/unsignaled
-    vk::assert_success(vk::WaitForFences(ctx_.dev, 1, &buf.present_fence, true, UINT64_MAX));
-    // reset the fence
-    vk::assert_success(vk::ResetFences(ctx_.dev, 1, &buf.present_fence));
+    wait_back_buffer(buf);
+    acquire_count_++;
+
+    // nothing presented to these is still pending
+    while (!retired_swapchains_.empty() && retired_swapchains_.front().release_acquire <= acquire_count_) {
+        destroy_retired_swapchain(retired_swapchains_.front());
+        retired_swapchains_.pop();
+    }
 
     VkResult res = VK_TIMEOUT; // Anything but VK_SUCCESS
     while (res != VK_SUCCESS) {
@@ -469,12 +715,15 @@ void Shell::acquire_back_buffer() {
         }
     }
 
+    // reset the fence; not before acquiring as resize_swapchain may wait for it
+    if (ctx_.present_pacing != PRESENT_PACING_WAIT) vk::assert_success(vk::ResetFences(ctx_.dev, 1, &buf.present_fence));
+
     ctx_.acquired_back_buffer = buf;
     ctx_.back_buffers.pop();
 }
 
 void Shell::present_back_buffer() {
-    const auto &buf = ctx_.acquired_back_buffer;
+    auto &buf = ctx_.acquired_back_buffer;
 
     if (!settings_.no_render) game_.on_frame(game_time_ / game_tick_);
 
@@ -491,6 +740,24 @@ void Shell::present_back_buffer() {
     present_info.pSwapchains = &ctx_.swapchain;
     present_info.pImageIndices = &buf.image_index;
 
+    // have the present itself tell us when buf can be reused
+    VkSwapchainPresentFenceInfoEXT present_fence_info = {};
+    VkPresentIdKHR present_id_info = {};
+    if (ctx_.present_pacing == PRESENT_PACING_FENCE) {
+        present_fence_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+        present_fence_info.swapchainCount = 1;
+        present_fence_info.pFences = &buf.present_fence;
+        present_info.pNext = &present_fence_info;
+    } else if (ctx_.present_pacing == PRESENT_PACING_WAIT) {
+        buf.present_id = ++present_id_;
+        buf.present_swapchain = ctx_.swapchain;
+
+        present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_id_info.swapchainCount = 1;
+        present_id_info.pPresentIds = &buf.present_id;
+        present_info.pNext = &present_id_info;
+    }
+
     VkResult res = vk::QueuePresentKHR(ctx_.present_queue, &present_info);
     if (res == VK_ERROR_OUT_OF_DATE_KHR) {
         // Swapchain is out of date (e.g. the window was resized) and
@@ -500,7 +767,8 @@ void Shell::present_back_buffer() {
         assert(!res);
     }
 
-    vk::assert_success(vk::QueueSubmit(ctx_.present_queue, 0, nullptr, buf.present_fence));
+    if (ctx_.present_pacing == PRESENT_PACING_SUBMIT)
+        vk::assert_success(vk::QueueSubmit(ctx_.present_queue, 0, nullptr, buf.present_fence));
     ctx_.back_buffers.push(buf);
 }
 
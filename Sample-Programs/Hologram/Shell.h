@@ -25,6 +25,7 @@
 #include "Game.h"
 
 class Game;
+class DeletionQueue;
 
 class Shell {
    public:
@@ -32,6 +33,15 @@ class Shell {
     Shell &operator=(const Shell &sh) = delete;
     virtual ~Shell() {}
 
+    enum PresentPacing {
+        // an empty submission signals present_fence after each present
+        PRESENT_PACING_SUBMIT,
+        // VK_EXT_swapchain_maintenance1 signals present_fence directly
+        PRESENT_PACING_FENCE,
+        // VK_KHR_present_wait waits for present_id to be presented
+        PRESENT_PACING_WAIT,
+    };
+
     struct BackBuffer {
         uint32_t image_index;
 
@@ -40,6 +50,9 @@ class Shell {
 
         // signaled when this struct is ready for reuse
         VkFence present_fence;
+        // or, with PRESENT_PACING_WAIT, ready once this present to present_swapchain is done
+        uint64_t present_id;
+        VkSwapchainKHR present_swapchain;
     };
 
     struct Context {
@@ -49,10 +62,17 @@ class Shell {
         VkPhysicalDevice physical_dev;
         uint32_t game_queue_family;
         uint32_t present_queue_family;
+        // dedicated families when available, otherwise the game queue family. compute_queue_family is
+        // VK_QUEUE_FAMILY_IGNORED and compute_queue is null when no family supports COMPUTE
+        uint32_t compute_queue_family;
+        uint32_t transfer_queue_family;
 
         VkDevice dev;
         VkQueue game_queue;
         VkQueue present_queue;
+        VkQueue compute_queue;
+        VkQueue transfer_queue;
+        PresentPacing present_pacing;
 
         std::queue<BackBuffer> back_buffers;
 
@@ -63,6 +83,10 @@ class Shell {
         VkExtent2D extent;
 
         BackBuffer acquired_back_buffer;
+
+        // for handles that frames in flight may still use; the game reports the fences of its frames to it, and the
+        // shell flushes it once the device is idle
+        DeletionQueue *deletion_queue;
     };
     const Context &context() const { return ctx_; }
 
@@ -93,6 +117,10 @@ class Shell {
     void acquire_back_buffer();
     void present_back_buffer();
 
+    // logs the present rate and the CPU time from input sampling until vkQueuePresentKHR returns every few seconds
+    void begin_profile(double time);
+    void profile_present(double input_time, double present_time);
+
     Game &game_;
     const Game::Settings &settings_;
 
@@ -113,6 +141,7 @@ class Shell {
 
     void assert_all_instance_layers() const;
     void assert_all_instance_extensions() const;
+    void add_optional_instance_extensions();
 
     bool has_all_device_layers(VkPhysicalDevice phy) const;
     bool has_all_device_extensions(VkPhysicalDevice phy) const;
@@ -123,6 +152,7 @@ class Shell {
     void init_instance();
     void init_debug_report();
     void init_physical_dev();
+    void init_async_queue_families(const std::vector<VkQueueFamilyProperties> &queues);
 
     // called by create_context
     void create_dev();
@@ -132,12 +162,39 @@ class Shell {
     void create_swapchain();
     void destroy_swapchain();
 
+    void wait_back_buffer(const BackBuffer &buf) const;
+    void wait_back_buffers() const;
     void fake_present();
 
+    // swapchains replaced by resize_swapchain, destroyed once every back buffer has been waited for again
+    struct RetiredSwapchain {
+        VkSwapchainKHR swapchain;
+        // with PRESENT_PACING_WAIT, the last present to it, if any
+        uint64_t present_id;
+        uint64_t release_acquire;
+    };
+
+    void destroy_retired_swapchain(const RetiredSwapchain &retired) const;
+
     Context ctx_;
 
+    bool has_physical_dev_properties2_;
+    bool has_surface_maintenance1_;
+
+    // the last id given to a present, and the last one given before the swapchain was recreated
+    uint64_t present_id_;
+    uint64_t present_id_base_;
+
+    // kept out of the deletion queue for the present wait, and released after it in the same frame
+    std::queue<RetiredSwapchain> retired_swapchains_;
+    uint64_t acquire_count_;
+
     const float game_tick_;
     float game_time_;
+
+    double profile_start_time_;
+    int profile_present_count_;
+    double profile_present_cpu_time_;
 };
 
 #endif  // SHELL_H
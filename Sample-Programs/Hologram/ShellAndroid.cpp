@@ -212,8 +212,14 @@ void ShellAndroid::run() {
     PosixTimer timer;
 
     double current_time = timer.get();
+    begin_profile(current_time);
 
     while (true) {
+        if (app_.window) game_.on_frame_begin();
+
+        // input is sampled from here on
+        const double input_time = timer.get();
+
         struct android_poll_source *source;
         while (true) {
             int timeout = (settings_.animate && app_.window) ? 0 : -1;
@@ -234,5 +240,7 @@ void ShellAndroid::run() {
         present_back_buffer();
 
         current_time = t;
+
+        profile_present(input_time, timer.get());
     }
 }
@@ -290,6 +290,8 @@ void ShellWayland::loop_wait() {
     while (true) {
         if (quit_) break;
 
+        game_.on_frame_begin();
+
         wl_display_dispatch_pending(display_);
 
         acquire_back_buffer();
@@ -301,12 +303,16 @@ void ShellWayland::loop_poll() {
     PosixTimer timer;
 
     double current_time = timer.get();
-    double profile_start_time = current_time;
-    int profile_present_count = 0;
+    begin_profile(current_time);
 
     while (true) {
         if (quit_) break;
 
+        game_.on_frame_begin();
+
+        // input is sampled from here on
+        const double input_time = timer.get();
+
         wl_display_dispatch_pending(display_);
 
         acquire_back_buffer();
@@ -318,17 +324,7 @@ void ShellWayland::loop_poll() {
 
         current_time = t;
 
-        profile_present_count++;
-        if (current_time - profile_start_time >= 5.0) {
-            const double fps = profile_present_count / (current_time - profile_start_time);
-            std::stringstream ss;
-            ss << profile_present_count << " presents in " << current_time - profile_start_time << " seconds "
-               << "(FPS: " << fps << ")";
-            log(LOG_INFO, ss.str().c_str());
-
-            profile_start_time = current_time;
-            profile_present_count = 0;
-        }
+        profile_present(input_time, timer.get());
     }
 }
 
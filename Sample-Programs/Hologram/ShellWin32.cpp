@@ -184,12 +184,18 @@ void ShellWin32::run() {
 
     Win32Timer timer;
     double current_time = timer.get();
+    begin_profile(current_time);
 
     while (true) {
         bool quit = false;
 
         assert(settings_.animate);
 
+        game_.on_frame_begin();
+
+        // input is sampled from here on
+        const double input_time = timer.get();
+
         // process all messages
         MSG msg;
         while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
@@ -212,6 +218,8 @@ void ShellWin32::run() {
         present_back_buffer();
 
         current_time = t;
+
+        profile_present(input_time, timer.get());
     }
 
     destroy_context();
@@ -81,7 +81,7 @@ Animation::Animation(unsigned int rng_seed, float scale) : rng_(rng_seed), dir_(
     current_.speed = speed_(rng_);
     current_.scale = scale;
 
-    current_.matrix = glm::scale(glm::mat4(1.0f), glm::vec3(current_.scale));
+    current_.angle = 0.0f;
 
     current_.alpha = current_.speed;
     current_.alpha_inc = current_.alpha > 0.5f ? 0.05f : -0.05f;
@@ -95,112 +95,75 @@ float Animation::transparency() {
     return current_.alpha;
 }
 
-glm::mat4 Animation::transformation(float t) {
-    current_.matrix = glm::rotate(current_.matrix, current_.speed * t, current_.axis);
+void Animation::advance(float t) {
+    const float two_pi = 6.28318530718f;
 
-    return current_.matrix;
+    current_.angle = std::fmod(current_.angle + current_.speed * t, two_pi);
 }
 
-class Curve {
-   public:
-    virtual ~Curve() {}
-    virtual glm::vec3 evaluate(float t) = 0;
-};
+void RandomCurve::reset() {
+    segment_start_ = glm::vec3(0.0f);
+    segment_direction_ = glm::vec3(0.0f);
+    time_start_ = 0.0f;
+    time_duration_ = 0.0f;
+}
 
-namespace {
+glm::vec3 RandomCurve::evaluate(float t, std::mt19937 &rng) {
+    if (t >= time_start_ + time_duration_) new_segment(t, rng);
 
-enum CurveType {
-    CURVE_RANDOM,
-    CURVE_CIRCLE,
-    CURVE_COUNT,
-};
+    pos_ += unit_dir_ * (t - last_);
+    last_ = t;
 
-class RandomCurve : public Curve {
-   public:
-    RandomCurve(unsigned int rng_seed)
-        : rng_(rng_seed),
-          direction_(-0.3f, 0.3f),
-          duration_(1.0f, 5.0f),
-          segment_start_(0.0f),
-          segment_direction_(0.0f),
-          time_start_(0.0f),
-          time_duration_(0.0f) {}
-
-    glm::vec3 evaluate(float t) {
-        if (t >= time_start_ + time_duration_) new_segment(t);
-
-        pos_ += unit_dir_ * (t - last_);
-        last_ = t;
-
-        return pos_;
-    }
+    return pos_;
+}
 
-   private:
-    void new_segment(float time_start) {
-        segment_start_ += segment_direction_;
-        segment_direction_ = glm::vec3(direction_(rng_), direction_(rng_), direction_(rng_));
+void RandomCurve::new_segment(float time_start, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> direction(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> duration(1.0f, 5.0f);
 
-        time_start_ = time_start;
-        time_duration_ = duration_(rng_);
+    segment_start_ += segment_direction_;
+    segment_direction_ = glm::vec3(direction(rng), direction(rng), direction(rng));
 
-        unit_dir_ = segment_direction_ / time_duration_;
-        pos_ = segment_start_;
-        last_ = time_start_;
-    }
+    time_start_ = time_start;
+    time_duration_ = duration(rng);
 
-    std::mt19937 rng_;
-    std::uniform_real_distribution<float> direction_;
-    std::uniform_real_distribution<float> duration_;
-
-    glm::vec3 segment_start_;
-    glm::vec3 segment_direction_;
-    float time_start_;
-    float time_duration_;
-
-    glm::vec3 unit_dir_;
-    glm::vec3 pos_;
-    float last_;
-};
+    unit_dir_ = segment_direction_ / time_duration_;
+    pos_ = segment_start_;
+    last_ = time_start_;
+}
 
-class CircleCurve : public Curve {
-   public:
-    CircleCurve(float radius, glm::vec3 axis) : r_(radius) {
-        glm::vec3 a;
-
-        if (axis.x != 0.0f) {
-            a.x = -axis.z / axis.x;
-            a.y = 0.0f;
-            a.z = 1.0f;
-        } else if (axis.y != 0.0f) {
-            a.x = 1.0f;
-            a.y = -axis.x / axis.y;
-            a.z = 0.0f;
-        } else {
-            a.x = 1.0f;
-            a.y = 0.0f;
-            a.z = -axis.x / axis.z;
-        }
+void CircleCurve::reset(float radius, glm::vec3 axis) {
+    r_ = radius;
 
-        a_ = glm::normalize(a);
-        b_ = glm::normalize(glm::cross(a_, axis));
-    }
+    glm::vec3 a;
 
-    glm::vec3 evaluate(float t) {
-        return (a_ * (glm::vec3(std::cos(t)) - glm::vec3(1.0f)) + b_ * glm::vec3(std::sin(t))) * glm::vec3(r_);
+    if (axis.x != 0.0f) {
+        a.x = -axis.z / axis.x;
+        a.y = 0.0f;
+        a.z = 1.0f;
+    } else if (axis.y != 0.0f) {
+        a.x = 1.0f;
+        a.y = -axis.x / axis.y;
+        a.z = 0.0f;
+    } else {
+        a.x = 1.0f;
+        a.y = 0.0f;
+        a.z = -axis.x / axis.z;
     }
 
-   private:
-    float r_;
-    glm::vec3 a_;
-    glm::vec3 b_;
-};
+    a_ = glm::normalize(a);
+    b_ = glm::normalize(glm::cross(a_, axis));
+}
 
-}  // namespace
+glm::vec3 CircleCurve::evaluate(float t) const {
+    return (a_ * (glm::vec3(std::cos(t)) - glm::vec3(1.0f)) + b_ * glm::vec3(std::sin(t))) * glm::vec3(r_);
+}
 
 Path::Path(unsigned int rng_seed) : rng_(rng_seed), type_(0, CURVE_COUNT - 1), duration_(5.0f, 20.0f) {
     // trigger a subpath generation
     current_.end = -1.0f;
     current_.now = 0.0f;
+    current_.curve_type = CURVE_NONE;
 }
 
 glm::vec3 Path::position(float t) {
@@ -208,15 +171,27 @@ glm::vec3 Path::position(float t) {
 
     while (current_.now >= current_.end) generate_subpath();
 
-    return current_.origin + current_.curve->evaluate(current_.now - current_.start);
+    return current_.origin + evaluate_curve(current_.now - current_.start);
+}
+
+glm::vec3 Path::evaluate_curve(float t) {
+    switch (current_.curve_type) {
+        case CURVE_RANDOM:
+            return current_.random_curve.evaluate(t, rng_);
+        case CURVE_CIRCLE:
+            return current_.circle_curve.evaluate(t);
+        default:
+            assert(!"unreachable");
+            return glm::vec3(0.0f);
+    }
 }
 
 void Path::generate_subpath() {
     float duration = duration_(rng_);
     CurveType type = static_cast<CurveType>(type_(rng_));
 
-    if (current_.curve) {
-        current_.origin += current_.curve->evaluate(current_.end - current_.start);
+    if (current_.curve_type != CURVE_NONE) {
+        current_.origin += evaluate_curve(current_.end - current_.start);
         current_.origin = glm::mod(current_.origin, glm::vec3(2.0f));
         current_.start = current_.end;
     } else {
@@ -227,11 +202,9 @@ void Path::generate_subpath() {
 
     current_.end = current_.start + duration;
 
-    Curve *curve;
-
     switch (type) {
         case CURVE_RANDOM:
-            curve = new RandomCurve(rng_());
+            current_.random_curve.reset();
             break;
         case CURVE_CIRCLE: {
             std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
@@ -239,15 +212,14 @@ void Path::generate_subpath() {
             if (axis.x == 0.0f && axis.y == 0.0f && axis.z == 0.0f) axis.x = 1.0f;
 
             std::uniform_real_distribution<float> radius_(0.02f, 0.2f);
-            curve = new CircleCurve(radius_(rng_), axis);
+            current_.circle_curve.reset(radius_(rng_), axis);
         } break;
         default:
             assert(!"unreachable");
-            curve = nullptr;
             break;
     }
 
-    current_.curve.reset(curve);
+    current_.curve_type = type;
 }
 
 Simulation::Simulation(int object_count) : random_dev_() {
@@ -264,6 +236,15 @@ Simulation::Simulation(int object_count) : random_dev_() {
             Path(random_dev_()),
         });
     }
+
+    // there is no previous tick to blend from yet
+    update(0.0f, 0, object_count);
+    for (auto &obj : objects_) {
+        obj.tick_pos[0] = obj.tick_pos[1];
+        obj.tick_rot[0] = obj.tick_rot[1];
+        obj.tick_alpha[0] = obj.tick_alpha[1];
+    }
+    interpolate(1.0f, 0, object_count);
 }
 
 void Simulation::set_frame_data_size(uint32_t size) {
@@ -278,9 +259,28 @@ void Simulation::update(float time, int begin, int end) {
     for (int i = begin; i < end; i++) {
         auto &obj = objects_[i];
 
-        glm::vec3 pos = obj.path.position(time);
-        glm::mat4 trans = obj.animation.transformation(time);
-        obj.model = glm::translate(glm::mat4(1.0f), pos) * trans;
-        obj.alpha = obj.animation.transparency();
+        obj.tick_pos[0] = obj.tick_pos[1];
+        obj.tick_rot[0] = obj.tick_rot[1];
+        obj.tick_alpha[0] = obj.tick_alpha[1];
+
+        obj.animation.advance(time);
+        obj.tick_pos[1] = obj.path.position(time);
+        obj.tick_rot[1] = obj.animation.rotation();
+        obj.tick_alpha[1] = obj.animation.transparency();
+
+        // the path wraps its origin around the cube; blending across that would sweep the object through it
+        if (glm::any(glm::greaterThan(glm::abs(obj.tick_pos[1] - obj.tick_pos[0]), glm::vec3(1.0f))))
+            obj.tick_pos[0] = obj.tick_pos[1];
+    }
+}
+
+void Simulation::interpolate(float frame_pred, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        auto &obj = objects_[i];
+
+        const glm::vec3 pos = glm::mix(obj.tick_pos[0], obj.tick_pos[1], frame_pred);
+        const glm::quat rot = glm::slerp(obj.tick_rot[0], obj.tick_rot[1], frame_pred);
+        obj.model = glm::scale(glm::translate(glm::mat4(1.0f), pos) * glm::mat4_cast(rot), glm::vec3(obj.animation.data().scale));
+        obj.alpha = glm::mix(obj.tick_alpha[0], obj.tick_alpha[1], frame_pred);
     }
 }
@@ -17,11 +17,11 @@
 #ifndef SIMULATION_H
 #define SIMULATION_H
 
-#include <memory>
 #include <random>
 #include <vector>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "Meshes.h"
 
@@ -29,21 +29,26 @@ class Animation {
    public:
     Animation(unsigned rng_seed, float scale);
 
-    glm::mat4 transformation(float t);
+    void advance(float t);
     float transparency();
 
-   private:
+    // derived from the angle in closed form, nothing accumulates but the angle itself
+    glm::quat rotation() const { return glm::angleAxis(current_.angle, current_.axis); }
+
     struct Data {
         glm::vec3 axis;
         float speed;
         float scale;
 
-        glm::mat4 matrix;
+        // about axis, kept in [0, 2pi)
+        float angle;
 
         float alpha;
         float alpha_inc;
     };
+    const Data &data() const { return current_; }
 
+   private:
     std::mt19937 rng_;
     std::uniform_real_distribution<float> dir_;
     std::uniform_real_distribution<float> speed_;
@@ -51,7 +56,35 @@ class Animation {
     Data current_;
 };
 
-class Curve;
+// subpath curves are stored inline in Path and evaluated without virtual calls
+class RandomCurve {
+   public:
+    void reset();
+    glm::vec3 evaluate(float t, std::mt19937 &rng);
+
+   private:
+    void new_segment(float time_start, std::mt19937 &rng);
+
+    glm::vec3 segment_start_;
+    glm::vec3 segment_direction_;
+    float time_start_;
+    float time_duration_;
+
+    glm::vec3 unit_dir_;
+    glm::vec3 pos_;
+    float last_;
+};
+
+class CircleCurve {
+   public:
+    void reset(float radius, glm::vec3 axis);
+    glm::vec3 evaluate(float t) const;
+
+   private:
+    float r_;
+    glm::vec3 a_;
+    glm::vec3 b_;
+};
 
 class Path {
    public:
@@ -60,15 +93,27 @@ class Path {
     glm::vec3 position(float t);
 
    private:
+    enum CurveType {
+        CURVE_RANDOM,
+        CURVE_CIRCLE,
+        CURVE_COUNT,
+        CURVE_NONE = CURVE_COUNT,
+    };
+
     struct Subpath {
         glm::vec3 origin;
         float start;
         float end;
         float now;
 
-        std::shared_ptr<Curve> curve;
+        // only the curve matching curve_type is live
+        CurveType curve_type;
+        RandomCurve random_curve;
+        CircleCurve circle_curve;
     };
 
+    glm::vec3 evaluate_curve(float t);
+
     void generate_subpath();
 
     std::mt19937 rng_;
@@ -92,6 +137,12 @@ class Simulation {
 
         uint32_t frame_data_offset;
 
+        // the previous and the latest tick
+        glm::vec3 tick_pos[2];
+        glm::quat tick_rot[2];
+        float tick_alpha[2];
+
+        // blended between the two ticks by interpolate
         glm::mat4 model;
         float alpha;
     };
@@ -102,6 +153,7 @@ class Simulation {
 
     void set_frame_data_size(uint32_t size);
     void update(float time, int begin, int end);
+    void interpolate(float frame_pred, int begin, int end);
 
    private:
     std::random_device random_dev_;
@@ -177,6 +177,8 @@ PFN_vkCreateAndroidSurfaceKHR CreateAndroidSurfaceKHR;
 PFN_vkCreateWin32SurfaceKHR CreateWin32SurfaceKHR;
 PFN_vkGetPhysicalDeviceWin32PresentationSupportKHR GetPhysicalDeviceWin32PresentationSupportKHR;
 #endif
+PFN_vkGetPhysicalDeviceFeatures2KHR GetPhysicalDeviceFeatures2KHR;
+PFN_vkWaitForPresentKHR WaitForPresentKHR;
 PFN_vkCreateDebugReportCallbackEXT CreateDebugReportCallbackEXT;
 PFN_vkDestroyDebugReportCallbackEXT DestroyDebugReportCallbackEXT;
 PFN_vkDebugReportMessageEXT DebugReportMessageEXT;
@@ -271,6 +273,8 @@ void init_dispatch_table_middle(VkInstance instance, bool include_bottom) {
     GetPhysicalDeviceWin32PresentationSupportKHR = reinterpret_cast<PFN_vkGetPhysicalDeviceWin32PresentationSupportKHR>(
         GetInstanceProcAddr(instance, "vkGetPhysicalDeviceWin32PresentationSupportKHR"));
 #endif
+    GetPhysicalDeviceFeatures2KHR =
+        reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(GetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
     CreateDebugReportCallbackEXT =
         reinterpret_cast<PFN_vkCreateDebugReportCallbackEXT>(GetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT"));
     DestroyDebugReportCallbackEXT =
@@ -427,6 +431,7 @@ void init_dispatch_table_middle(VkInstance instance, bool include_bottom) {
     QueuePresentKHR = reinterpret_cast<PFN_vkQueuePresentKHR>(GetInstanceProcAddr(instance, "vkQueuePresentKHR"));
     CreateSharedSwapchainsKHR =
         reinterpret_cast<PFN_vkCreateSharedSwapchainsKHR>(GetInstanceProcAddr(instance, "vkCreateSharedSwapchainsKHR"));
+    WaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(GetInstanceProcAddr(instance, "vkWaitForPresentKHR"));
 }
 
 void init_dispatch_table_bottom(VkInstance instance, VkDevice dev) {
@@ -571,6 +576,7 @@ void init_dispatch_table_bottom(VkInstance instance, VkDevice dev) {
     QueuePresentKHR = reinterpret_cast<PFN_vkQueuePresentKHR>(GetDeviceProcAddr(dev, "vkQueuePresentKHR"));
     CreateSharedSwapchainsKHR =
         reinterpret_cast<PFN_vkCreateSharedSwapchainsKHR>(GetDeviceProcAddr(dev, "vkCreateSharedSwapchainsKHR"));
+    WaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(GetDeviceProcAddr(dev, "vkWaitForPresentKHR"));
 }
 
 }  // namespace vk
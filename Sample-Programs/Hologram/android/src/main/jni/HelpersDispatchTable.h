@@ -200,6 +200,12 @@ extern PFN_vkCreateWin32SurfaceKHR CreateWin32SurfaceKHR;
 extern PFN_vkGetPhysicalDeviceWin32PresentationSupportKHR GetPhysicalDeviceWin32PresentationSupportKHR;
 #endif
 
+// VK_KHR_get_physical_device_properties2
+extern PFN_vkGetPhysicalDeviceFeatures2KHR GetPhysicalDeviceFeatures2KHR;
+
+// VK_KHR_present_wait
+extern PFN_vkWaitForPresentKHR WaitForPresentKHR;
+
 // VK_EXT_debug_report
 extern PFN_vkCreateDebugReportCallbackEXT CreateDebugReportCallbackEXT;
 extern PFN_vkDestroyDebugReportCallbackEXT DestroyDebugReportCallbackEXT;